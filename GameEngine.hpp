@@ -1,7 +1,73 @@
 #ifndef GAME_ENGINE_HPP
 #define GAME_ENGINE_HPP
 
+#ifdef GAME_ENGINE_HEADLESS
+// Headless builds don't depend on raylib at all. These are minimal
+// stand-ins (same layout and values as raylib) for the types, colors,
+// keys and helpers the engine and simulation code use; nothing here draws.
+struct Vector2 { float x; float y; };
+struct Rectangle { float x; float y; float width; float height; };
+struct Color { unsigned char r; unsigned char g; unsigned char b; unsigned char a; };
+struct Texture2D { unsigned int id; int width; int height; int mipmaps; int format; };
+using Texture = Texture2D;
+struct Camera2D { Vector2 offset; Vector2 target; float rotation; float zoom; };
+
+#ifndef PI
+#define PI 3.14159265358979323846f
+#endif
+#define DEG2RAD (PI/180.0f)
+#define RAD2DEG (180.0f/PI)
+
+#define LIGHTGRAY  Color{ 200, 200, 200, 255 }
+#define GRAY       Color{ 130, 130, 130, 255 }
+#define DARKGRAY   Color{ 80, 80, 80, 255 }
+#define YELLOW     Color{ 253, 249, 0, 255 }
+#define GOLD       Color{ 255, 203, 0, 255 }
+#define ORANGE     Color{ 255, 161, 0, 255 }
+#define PINK       Color{ 255, 109, 194, 255 }
+#define RED        Color{ 230, 41, 55, 255 }
+#define MAROON     Color{ 190, 33, 55, 255 }
+#define GREEN      Color{ 0, 228, 48, 255 }
+#define LIME       Color{ 0, 158, 47, 255 }
+#define DARKGREEN  Color{ 0, 117, 44, 255 }
+#define SKYBLUE    Color{ 102, 191, 255, 255 }
+#define BLUE       Color{ 0, 121, 241, 255 }
+#define DARKBLUE   Color{ 0, 82, 172, 255 }
+#define PURPLE     Color{ 200, 122, 255, 255 }
+#define VIOLET     Color{ 135, 60, 190, 255 }
+#define DARKPURPLE Color{ 112, 31, 126, 255 }
+#define BEIGE      Color{ 211, 176, 131, 255 }
+#define BROWN      Color{ 127, 106, 79, 255 }
+#define DARKBROWN  Color{ 76, 63, 47, 255 }
+#define WHITE      Color{ 255, 255, 255, 255 }
+#define BLACK      Color{ 0, 0, 0, 255 }
+#define BLANK      Color{ 0, 0, 0, 0 }
+#define MAGENTA    Color{ 255, 0, 255, 255 }
+#define RAYWHITE   Color{ 245, 245, 245, 255 }
+
+enum KeyboardKey {
+    KEY_NULL = 0,
+    KEY_APOSTROPHE = 39, KEY_COMMA = 44, KEY_MINUS = 45, KEY_PERIOD = 46, KEY_SLASH = 47,
+    KEY_ZERO = 48, KEY_ONE, KEY_TWO, KEY_THREE, KEY_FOUR, KEY_FIVE, KEY_SIX, KEY_SEVEN, KEY_EIGHT, KEY_NINE,
+    KEY_SEMICOLON = 59, KEY_EQUAL = 61,
+    KEY_A = 65, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+    KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z,
+    KEY_SPACE = 32, KEY_ESCAPE = 256, KEY_ENTER = 257, KEY_TAB = 258, KEY_BACKSPACE = 259,
+    KEY_INSERT = 260, KEY_DELETE = 261,
+    KEY_RIGHT = 262, KEY_LEFT = 263, KEY_DOWN = 264, KEY_UP = 265,
+    KEY_F1 = 290, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
+    KEY_LEFT_SHIFT = 340, KEY_LEFT_CONTROL = 341, KEY_LEFT_ALT = 342,
+    KEY_RIGHT_SHIFT = 344, KEY_RIGHT_CONTROL = 345, KEY_RIGHT_ALT = 346
+};
+
+inline bool CheckCollisionRecs(Rectangle a, Rectangle b) {
+    return a.x < b.x + b.width && a.x + a.width > b.x &&
+           a.y < b.y + b.height && a.y + a.height > b.y;
+}
+#else
 #include "raylib.h"
+#include "rlgl.h"
+#endif
 #include <vector>
 #include <memory>
 #include <string>
@@ -10,291 +76,5588 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <cstdint>
+#include <climits>
+#include <cassert>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <bitset>
+#include <type_traits>
+#include <fstream>
+#include <iomanip>
+#include <unordered_set>
+#include <memory_resource>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <typeindex>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GAME_ENGINE_HAS_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GAME_ENGINE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Time management. Get() is the step the simulation is currently
+// advancing by: the fixed tick length under GameEngine's fixed-step loop,
+// or the measured frame time when a scene is updated with a variable step.
+class DeltaTime {
+private:
+    static float deltaTime;
+    static float frameTime;
+    static float interpolation;
+    static std::chrono::steady_clock::time_point lastTime;
+
+public:
+    // Measures wall-clock time since the previous call and uses it as the step
+    static void Update() {
+        deltaTime = Tick();
+    }
+
+    // Measures wall-clock time since the previous call without touching the step
+    static float Tick() {
+        auto currentTime = std::chrono::steady_clock::now();
+        frameTime = std::chrono::duration<float>(currentTime - lastTime).count();
+        lastTime = currentTime;
+        return frameTime;
+    }
+
+    static void Set(float step) { deltaTime = step; }
+    static void SetInterpolation(float alpha) { interpolation = alpha; }
+
+    static float Get() { return deltaTime; }
+    static float GetFrameTime() { return frameTime; }
+    // Fraction of a tick elapsed since the last simulation step, in [0, 1]
+    static float GetInterpolation() { return interpolation; }
+};
+
+float DeltaTime::deltaTime = 0.0f;
+float DeltaTime::frameTime = 0.0f;
+float DeltaTime::interpolation = 1.0f;
+std::chrono::steady_clock::time_point DeltaTime::lastTime = std::chrono::steady_clock::now();
+
+// Frame profiler. ProfileZone is an RAII marker; nested zones form a
+// hierarchy through a per-thread depth counter. Each thread appends finished
+// zones to its own fixed-size ring buffer without locking (single writer);
+// readers copy the rings for the debug overlay or a Chrome trace export.
+// Recording is off until Profiler::SetEnabled(true); defining
+// GAME_ENGINE_DISABLE_PROFILER compiles every PROFILE_ZONE out.
+class Profiler {
+public:
+    struct Event {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+        uint32_t depth;
+        uint32_t thread;
+    };
+
+private:
+    static constexpr size_t RingCapacity = 16384;
+
+    struct ThreadBuffer {
+        Event events[RingCapacity];
+        std::atomic<uint64_t> head{0};
+        uint32_t thread = 0;
+        uint32_t depth = 0;
+    };
+
+    struct State {
+        std::mutex mutex; // Guards buffer registration only
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::atomic<bool> enabled{false};
+        std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        std::atomic<uint64_t> frameStart{0};
+        std::atomic<uint64_t> lastFrameStart{0};
+        std::unordered_set<std::string> names;
+    };
+
+    static State& Get() {
+        static State state;
+        return state;
+    }
+
+    static ThreadBuffer& Local() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            State& state = Get();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.buffers.push_back(std::make_unique<ThreadBuffer>());
+            buffer = state.buffers.back().get();
+            buffer->thread = static_cast<uint32_t>(state.buffers.size() - 1);
+        }
+        return *buffer;
+    }
+
+public:
+    static uint64_t Now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - Get().epoch).count());
+    }
+
+    // Zone names are stored as raw pointers, so names built at runtime must
+    // outlive every export; interned names live as long as the program.
+    static const char* Intern(const std::string& name) {
+        State& state = Get();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        return state.names.insert(name).first->c_str();
+    }
+
+    static void SetEnabled(bool enabled) { Get().enabled.store(enabled, std::memory_order_relaxed); }
+    static bool IsEnabled() { return Get().enabled.load(std::memory_order_relaxed); }
+
+    // Called once per rendered frame; the overlay shows the last whole frame
+    static void MarkFrame() {
+        State& state = Get();
+        state.lastFrameStart.store(state.frameStart.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        state.frameStart.store(Now(), std::memory_order_relaxed);
+    }
+
+    static uint64_t LastFrameStart() { return Get().lastFrameStart.load(std::memory_order_relaxed); }
+    static uint64_t FrameStart() { return Get().frameStart.load(std::memory_order_relaxed); }
+
+    static uint32_t BeginZone() {
+        return Local().depth++;
+    }
+
+    static void EndZone(const char* name, uint64_t startNs, uint32_t depth) {
+        ThreadBuffer& buffer = Local();
+        buffer.depth = depth;
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        buffer.events[head % RingCapacity] = Event{name, startNs, Now(), depth, buffer.thread};
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Copies recorded zones that ended at or after sinceNs. A thread writing
+    // while this runs may overwrite the oldest entries being copied; that only
+    // affects zones about to fall out of the ring anyway.
+    static void Collect(std::vector<Event>& out, uint64_t sinceNs = 0) {
+        State& state = Get();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (auto& buffer : state.buffers) {
+            uint64_t head = buffer->head.load(std::memory_order_acquire);
+            uint64_t first = head > RingCapacity ? head - RingCapacity : 0;
+            for (uint64_t i = first; i < head; i++) {
+                const Event& event = buffer->events[i % RingCapacity];
+                if (event.endNs >= sinceNs) out.push_back(event);
+            }
+        }
+    }
+
+    // Writes everything still in the rings in Chrome's trace event format
+    // (load in chrome://tracing or Perfetto).
+    static bool ExportChromeTrace(const std::string& path) {
+        std::vector<Event> events;
+        Collect(events);
+        std::ofstream file(path);
+        if (!file) return false;
+        file << "{\"traceEvents\":[\n";
+        for (size_t i = 0; i < events.size(); i++) {
+            const Event& e = events[i];
+            file << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                 << ",\"ts\":" << e.startNs / 1000.0 << ",\"dur\":" << (e.endNs - e.startNs) / 1000.0 << "}"
+                 << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        file << "]}\n";
+        return static_cast<bool>(file);
+    }
+};
+
+class ProfileZone {
+private:
+    const char* name;
+    uint64_t start = 0;
+    uint32_t depth = 0;
+    bool recording;
+
+public:
+    explicit ProfileZone(const char* zoneName)
+        : name(zoneName), recording(Profiler::IsEnabled()) {
+        if (!recording) return;
+        depth = Profiler::BeginZone();
+        start = Profiler::Now();
+    }
+
+    ~ProfileZone() {
+        if (recording) Profiler::EndZone(name, start, depth);
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define GAME_ENGINE_CONCAT_INNER(a, b) a##b
+#define GAME_ENGINE_CONCAT(a, b) GAME_ENGINE_CONCAT_INNER(a, b)
+#ifdef GAME_ENGINE_DISABLE_PROFILER
+#define PROFILE_ZONE(name) ((void)0)
+#else
+#define PROFILE_ZONE(name) ProfileZone GAME_ENGINE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+// Heap allocation counter. Counting replaces the global operator new, so
+// it is opt-in: define GAME_ENGINE_ALLOCATION_HOOK before including this
+// header. Without the hook Get() stays 0 and IsInstalled() is false.
+struct AllocationCounter {
+    static inline std::atomic<uint64_t> count{0};
+    static inline bool installed = false;
+
+    static uint64_t Get() { return count.load(std::memory_order_relaxed); }
+    static bool IsInstalled() { return installed; }
+};
+
+#ifdef GAME_ENGINE_ALLOCATION_HOOK
+static const bool gameEngineAllocationHookInstalled = (AllocationCounter::installed = true);
+
+// Kept out of line: once GCC inlines these it pairs the malloc in new
+// with the free in delete and reports them as mismatched
+#if defined(__GNUC__)
+#define GAME_ENGINE_NOINLINE __attribute__((noinline))
+#else
+#define GAME_ENGINE_NOINLINE
+#endif
+
+GAME_ENGINE_NOINLINE void* operator new(size_t size) {
+    AllocationCounter::count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+GAME_ENGINE_NOINLINE void* operator new[](size_t size) { return ::operator new(size); }
+
+GAME_ENGINE_NOINLINE void* operator new(size_t size, std::align_val_t align) {
+    AllocationCounter::count.fetch_add(1, std::memory_order_relaxed);
+    size_t alignment = std::max(static_cast<size_t>(align), sizeof(void*));
+    size = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    if (void* p = std::aligned_alloc(alignment, size)) return p;
+    throw std::bad_alloc();
+}
+
+GAME_ENGINE_NOINLINE void* operator new[](size_t size, std::align_val_t align) { return ::operator new(size, align); }
+
+GAME_ENGINE_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete(void* p, size_t) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete[](void* p, size_t) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+GAME_ENGINE_NOINLINE void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
+
+// Linear allocator for data that lives until the end of the frame. Each
+// allocation bumps an offset; nothing is freed individually and Reset()
+// rewinds everything at once. Running out of space chains another block,
+// and the next Reset() merges the blocks into one big enough for the whole
+// frame, so a steady workload stops touching the heap after a frame or two.
+// Use it through the std::pmr interface (FrameVector<T>). Not thread-safe:
+// allocate from one thread, or give each job its own arena.
+class FrameArena : public std::pmr::memory_resource {
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0; // Block being bumped
+    size_t offset = 0;
+    size_t used = 0;
+    size_t peak = 0;
+
+    void AddBlock(size_t minimum) {
+        size_t size = std::max(minimum, blocks.empty() ? size_t(0) : blocks.back().size * 2);
+        blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        for (;;) {
+            Block& block = blocks[current];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t aligned = ((base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+            if (aligned + bytes <= block.size) {
+                used += aligned + bytes - offset;
+                peak = std::max(peak, used);
+                offset = aligned + bytes;
+                return block.data.get() + aligned;
+            }
+            if (current + 1 == blocks.size()) AddBlock(bytes + alignment);
+            current++;
+            offset = 0;
+        }
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit FrameArena(size_t capacity = 256 * 1024) {
+        AddBlock(std::max<size_t>(capacity, 64));
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Invalidates everything allocated since the last reset
+    void Reset() {
+        if (blocks.size() > 1) {
+            size_t total = 0;
+            for (const auto& block : blocks) total += block.size;
+            blocks.clear();
+            AddBlock(total);
+        }
+        current = 0;
+        offset = 0;
+        used = 0;
+    }
+
+    size_t Used() const { return used; }
+    size_t PeakUsed() const { return peak; }
+
+    size_t Capacity() const {
+        size_t total = 0;
+        for (const auto& block : blocks) total += block.size;
+        return total;
+    }
+};
+
+template<typename T>
+using FrameVector = std::pmr::vector<T>;
+
+// Fixed-size block pools for long-lived objects such as entities. Each
+// size class carves blocks out of slabs (growing from 64 to 4096 blocks per
+// slab) and recycles them through an intrusive free list, so objects of one
+// type sit next to each other in allocation order instead of wherever the
+// heap puts them. Not thread-safe.
+class SlabPools {
+private:
+    struct Pool {
+        size_t blockSize = 0;
+        size_t alignment = 0;
+        size_t nextSlabBlocks = 64;
+        std::vector<void*> slabs;
+        void* freeList = nullptr;
+        size_t live = 0;
+    };
+
+    static constexpr size_t MaxSlabBlocks = 4096;
+
+    std::vector<Pool> pools;
+
+    Pool& PoolFor(size_t size, size_t alignment) {
+        alignment = std::max(alignment, alignof(void*));
+        size_t blockSize = (std::max(size, sizeof(void*)) + alignment - 1) / alignment * alignment;
+        for (auto& pool : pools) {
+            if (pool.blockSize == blockSize && pool.alignment == alignment) return pool;
+        }
+        pools.emplace_back();
+        pools.back().blockSize = blockSize;
+        pools.back().alignment = alignment;
+        return pools.back();
+    }
+
+    static void Grow(Pool& pool) {
+        size_t blocks = pool.nextSlabBlocks;
+        pool.nextSlabBlocks = std::min(blocks * 2, MaxSlabBlocks);
+        auto* slab = static_cast<unsigned char*>(
+            ::operator new(blocks * pool.blockSize, std::align_val_t(pool.alignment)));
+        pool.slabs.push_back(slab);
+        // Thread the free list front to back so allocation order matches address order
+        for (size_t i = blocks; i-- > 0;) {
+            void* block = slab + i * pool.blockSize;
+            *static_cast<void**>(block) = pool.freeList;
+            pool.freeList = block;
+        }
+    }
+
+public:
+    SlabPools() = default;
+    SlabPools(const SlabPools&) = delete;
+    SlabPools& operator=(const SlabPools&) = delete;
+
+    // Every block must have been returned by now
+    ~SlabPools() {
+        for (auto& pool : pools) {
+            assert(pool.live == 0);
+            for (void* slab : pool.slabs) ::operator delete(slab, std::align_val_t(pool.alignment));
+        }
+    }
+
+    void* Allocate(size_t size, size_t alignment) {
+        Pool& pool = PoolFor(size, alignment);
+        if (!pool.freeList) Grow(pool);
+        void* block = pool.freeList;
+        pool.freeList = *static_cast<void**>(block);
+        pool.live++;
+        return block;
+    }
+
+    void Deallocate(void* block, size_t size, size_t alignment) {
+        Pool& pool = PoolFor(size, alignment);
+        *static_cast<void**>(block) = pool.freeList;
+        pool.freeList = block;
+        pool.live--;
+    }
+
+    // Blocks in use across all size classes
+    size_t Live() const {
+        size_t total = 0;
+        for (const auto& pool : pools) total += pool.live;
+        return total;
+    }
+};
+
+// Standard allocator over SlabPools; single-object allocations come from
+// the slabs, anything else goes to the heap. Shares ownership of the pools,
+// so a shared_ptr made with allocate_shared keeps its slab alive.
+template<typename T>
+struct SlabAllocator {
+    using value_type = T;
+
+    std::shared_ptr<SlabPools> pools;
+
+    explicit SlabAllocator(std::shared_ptr<SlabPools> owner) : pools(std::move(owner)) {}
+
+    template<typename U>
+    SlabAllocator(const SlabAllocator<U>& other) : pools(other.pools) {}
+
+    T* allocate(size_t n) {
+        if (n == 1) return static_cast<T*>(pools->Allocate(sizeof(T), alignof(T)));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n == 1) pools->Deallocate(p, sizeof(T), alignof(T));
+        else std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const SlabAllocator<U>& other) const { return pools == other.pools; }
+    template<typename U>
+    bool operator!=(const SlabAllocator<U>& other) const { return pools != other.pools; }
+};
+
+// Per-tick input stream plus a hash of the scene after every tick, for
+// deterministic replays. Keys are stored as changes (tick, key, down), so a
+// recording costs a few bytes per key press rather than per tick.
+struct InputRecording {
+    struct KeyEvent {
+        uint32_t tick;
+        uint16_t key;
+        uint8_t down;
+        uint8_t reserved;
+    };
+
+    struct TickRecord {
+        float dt;
+        uint32_t reserved;
+        uint64_t stateHash;
+    };
+
+    static constexpr uint32_t Version = 1;
+
+    uint64_t seed = 0; // Random seed the run started from
+    std::vector<KeyEvent> events;
+    std::vector<TickRecord> ticks;
+
+    void Clear() {
+        events.clear();
+        ticks.clear();
+    }
+
+    bool Save(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary);
+        const uint32_t header[4] = {0x52494547u /* "GEIR" */, Version,
+                                    static_cast<uint32_t>(events.size()), static_cast<uint32_t>(ticks.size())};
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(&seed), sizeof(seed));
+        file.write(reinterpret_cast<const char*>(events.data()), events.size() * sizeof(KeyEvent));
+        file.write(reinterpret_cast<const char*>(ticks.data()), ticks.size() * sizeof(TickRecord));
+        return file.good();
+    }
+
+    bool Load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        const uint64_t size = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+        uint32_t header[4];
+        if (size < sizeof(header) + sizeof(seed) ||
+            !file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+            header[0] != 0x52494547u || header[1] == 0 || header[1] > Version) {
+            return false;
+        }
+        const uint64_t expected = sizeof(header) + sizeof(seed) +
+                                  uint64_t{header[2]} * sizeof(KeyEvent) + uint64_t{header[3]} * sizeof(TickRecord);
+        if (expected != size) return false;
+        events.resize(header[2]);
+        ticks.resize(header[3]);
+        file.read(reinterpret_cast<char*>(&seed), sizeof(seed));
+        file.read(reinterpret_cast<char*>(events.data()), events.size() * sizeof(KeyEvent));
+        file.read(reinterpret_cast<char*>(ticks.data()), ticks.size() * sizeof(TickRecord));
+        return file.good();
+    }
+};
+
+// Keyboard input. Live mode forwards to raylib; scripted mode (always on in
+// headless builds) answers from a per-tick key state filled by a script, so
+// simulations can run without a window. While recording, the key state is
+// latched once per tick (from the keyboard, or the script if one is set)
+// and every change is appended to the recording; replay feeds the recorded
+// changes back in at the same ticks.
+class Input {
+public:
+    static constexpr int KeyCount = 512;
+    using Script = std::function<void(uint64_t tick)>;
+
+private:
+    static std::bitset<KeyCount> down;
+    static std::bitset<KeyCount> previous;
+    static Script script;
+    static uint64_t tick;
+    static InputRecording* recording;
+    static const InputRecording* replay;
+    static uint32_t streamTick;   // Ticks since recording/replay started
+    static size_t replayCursor;
+
+    static bool Latched() {
+        return script || recording || replay;
+    }
+
+public:
+    // script(tick) runs at the start of every tick and sets keys with SetKeyDown
+    static void SetScript(Script tickScript) {
+        script = std::move(tickScript);
+        down.reset();
+        previous.reset();
+    }
+
+    static void SetKeyDown(int key, bool isDown) {
+        if (key >= 0 && key < KeyCount) down[key] = isDown;
+    }
+
+    // Appends every tick's key changes to `target` until StopStream
+    static void StartRecording(InputRecording& target) {
+        StopStream();
+        recording = &target;
+        down.reset();
+        previous.reset();
+    }
+
+    // Replaces live and scripted input with `source` until StopStream
+    static void StartReplay(const InputRecording& source) {
+        StopStream();
+        replay = &source;
+        down.reset();
+        previous.reset();
+    }
+
+    static void StopStream() {
+        recording = nullptr;
+        replay = nullptr;
+        streamTick = 0;
+        replayCursor = 0;
+    }
+
+    static bool IsRecording() { return recording != nullptr; }
+    static bool IsReplaying() { return replay != nullptr; }
+
+    // Called by GameEngine before every simulation tick
+    static void BeginTick() {
+        previous = down;
+        if (replay) {
+            const auto& events = replay->events;
+            for (; replayCursor < events.size() && events[replayCursor].tick <= streamTick; replayCursor++) {
+                SetKeyDown(events[replayCursor].key, events[replayCursor].down != 0);
+            }
+        } else if (script) {
+            script(tick);
+        } else if (recording) {
+#ifndef GAME_ENGINE_HEADLESS
+            for (int key = 0; key < KeyCount; key++) down[key] = ::IsKeyDown(key);
+#endif
+        }
+        if (recording) {
+            const std::bitset<KeyCount> changed = down ^ previous;
+            if (changed.any()) {
+                for (int key = 0; key < KeyCount; key++) {
+                    if (!changed[key]) continue;
+                    recording->events.push_back(InputRecording::KeyEvent{
+                        streamTick, static_cast<uint16_t>(key), static_cast<uint8_t>(down[key]), 0});
+                }
+            }
+        }
+        if (recording || replay) streamTick++;
+        tick++;
+    }
+
+    static uint64_t GetTick() { return tick; }
+
+    static bool IsKeyDown(int key) {
+#ifndef GAME_ENGINE_HEADLESS
+        if (!Latched()) return ::IsKeyDown(key);
+#endif
+        return key >= 0 && key < KeyCount && down[key];
+    }
+
+    static bool IsKeyPressed(int key) {
+#ifndef GAME_ENGINE_HEADLESS
+        if (!Latched()) return ::IsKeyPressed(key);
+#endif
+        return key >= 0 && key < KeyCount && down[key] && !previous[key];
+    }
+
+    // Per-frame press for UI and meta keys (debug toggles, starting and
+    // stopping a recording). Read straight from the keyboard: never
+    // latched, recorded or replayed, and fires once per press however many
+    // ticks the frame runs. Always false in headless builds.
+    static bool IsFrameKeyPressed([[maybe_unused]] int key) {
+#ifndef GAME_ENGINE_HEADLESS
+        return ::IsKeyPressed(key);
+#else
+        return false;
+#endif
+    }
+};
+
+std::bitset<Input::KeyCount> Input::down;
+std::bitset<Input::KeyCount> Input::previous;
+Input::Script Input::script;
+uint64_t Input::tick = 0;
+InputRecording* Input::recording = nullptr;
+const InputRecording* Input::replay = nullptr;
+uint32_t Input::streamTick = 0;
+size_t Input::replayCursor = 0;
+
+// Job system. One worker thread per extra core, each with its own job
+// deque: owners pop from the back, idle workers steal from the front of
+// other deques. The thread calling ParallelFor helps run jobs until its
+// range completes, so nested ParallelFor calls cannot deadlock.
+class JobSystem {
+private:
+    struct Job {
+        void (*run)(const void* context, size_t begin, size_t end);
+        const void* context;
+        size_t begin;
+        size_t end;
+        std::atomic<size_t>* remaining;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // One per worker
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> nextQueue{0};
+    bool deterministic = false;
+
+    static thread_local int workerIndex;
+
+    bool PopOwn(size_t index, Job& job) {
+        Queue& q = *queues[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.jobs.empty()) return false;
+        job = q.jobs.back();
+        q.jobs.pop_back();
+        return true;
+    }
+
+    bool Steal(size_t thief, Job& job) {
+        for (size_t k = 1; k <= queues.size(); k++) {
+            Queue& q = *queues[(thief + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.jobs.empty()) continue;
+            job = q.jobs.front();
+            q.jobs.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool TryRunOne() {
+        if (queues.empty()) return false;
+        Job job;
+        size_t self = workerIndex >= 0 ? static_cast<size_t>(workerIndex) : 0;
+        bool found = (workerIndex >= 0 && PopOwn(self, job)) || Steal(self, job);
+        if (!found) return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        job.run(job.context, job.begin, job.end);
+        job.remaining->fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    void WorkerLoop(int index) {
+        workerIndex = index;
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (TryRunOne()) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] {
+                return stopping.load(std::memory_order_acquire) || queued.load(std::memory_order_acquire) > 0;
+            });
+        }
+    }
+
+public:
+    // threadCount = 0 picks one worker per hardware thread besides the caller
+    explicit JobSystem(size_t threadCount = 0) {
+        if (threadCount == 0) {
+            unsigned int hardware = std::thread::hardware_concurrency();
+            threadCount = hardware > 1 ? hardware - 1 : 0;
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back(&JobSystem::WorkerLoop, this, static_cast<int>(i));
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping.store(true, std::memory_order_release);
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static JobSystem& Default() {
+        static JobSystem instance;
+        return instance;
+    }
+
+    size_t WorkerCount() const { return workers.size(); }
+
+    // Index of the worker running the calling thread, -1 off the pool
+    static int CurrentWorker() { return workerIndex; }
+
+    // Deterministic mode runs every range serially, in order, on the
+    // calling thread, so results never depend on scheduling.
+    void SetDeterministic(bool enabled) { deterministic = enabled; }
+    bool IsDeterministic() const { return deterministic; }
+
+    // Calls fn(begin, end) over [0, count) in chunks of about `grain`
+    // items and returns when all chunks are done.
+    template<typename Fn>
+    void ParallelFor(size_t count, size_t grain, const Fn& fn) {
+        if (count == 0) return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        if (deterministic || workers.empty() || chunks == 1) {
+            for (size_t begin = 0; begin < count; begin += grain) {
+                fn(begin, std::min(count, begin + grain));
+            }
+            return;
+        }
+
+        std::atomic<size_t> remaining{chunks};
+        auto run = [](const void* context, size_t begin, size_t end) {
+            (*static_cast<const Fn*>(context))(begin, end);
+        };
+        // Keep the first chunk for the calling thread
+        for (size_t c = 1; c < chunks; c++) {
+            size_t begin = c * grain;
+            Queue& q = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.jobs.push_back(Job{run, &fn, begin, std::min(count, begin + grain), &remaining});
+            queued.fetch_add(1, std::memory_order_release);
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_all();
+
+        fn(0, std::min(count, grain));
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!TryRunOne()) std::this_thread::yield();
+        }
+    }
+};
+
+thread_local int JobSystem::workerIndex = -1;
+
+// xoshiro128+ generator: 16 bytes of state and a handful of ALU ops per
+// number, plenty for gameplay and effects (not for anything security
+// related). Seeds go through SplitMix64 so nearby seeds give unrelated streams.
+class Rng {
+private:
+    uint32_t state[4];
+
+    static uint32_t Rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+    // 1024 unit vectors around the circle, shared by every generator
+    static const Vector2* DirectionTable() {
+        static const std::vector<Vector2> table = [] {
+            std::vector<Vector2> directions(1024);
+            for (size_t i = 0; i < directions.size(); i++) {
+                float angle = (static_cast<float>(i) + 0.5f) * (2.0f * PI / directions.size());
+                directions[i] = Vector2{cosf(angle), sinf(angle)};
+            }
+            return directions;
+        }();
+        return table.data();
+    }
+
+public:
+    explicit Rng(uint64_t seed = 0x853c49e6748fea9bull) { Seed(seed); }
+
+    void Seed(uint64_t seed) {
+        for (auto& word : state) {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            word = static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+        }
+    }
+
+    uint32_t Next() {
+        const uint32_t result = state[0] + state[3];
+        const uint32_t t = state[1] << 9;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = Rotl(state[3], 11);
+        return result;
+    }
+
+    // Uniform in [0, 1), from the top 24 bits
+    float Float() { return static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f); }
+
+    float Range(float low, float high) { return low + (high - low) * Float(); }
+
+    // Uniform random direction, quantized to 1024 steps around the circle
+    Vector2 Direction() { return DirectionTable()[Next() >> 22]; }
+
+    // Bulk forms for burst emission
+    void FillRange(float* out, size_t count, float low, float high) {
+        const float scale = (high - low) * (1.0f / 16777216.0f);
+        for (size_t i = 0; i < count; i++) out[i] = low + static_cast<float>(Next() >> 8) * scale;
+    }
+
+    void FillDirections(Vector2* out, size_t count) {
+        const Vector2* table = DirectionTable();
+        for (size_t i = 0; i < count; i++) out[i] = table[Next() >> 22];
+    }
+};
+
+// Engine-wide random numbers. Each thread gets its own generator (no
+// locking, no shared state), seeded from the global seed and the thread's
+// job-system worker index, so a run is reproducible for a given seed as
+// long as the same work lands on the same worker (always true in
+// deterministic mode). Seed() reseeds every thread's generator lazily.
+class Random {
+private:
+    static inline std::atomic<uint64_t> seed{0x853c49e6748fea9bull};
+    static inline std::atomic<uint32_t> generation{1};
+
+public:
+    static void Seed(uint64_t value) {
+        seed.store(value, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    static uint64_t GetSeed() { return seed.load(std::memory_order_relaxed); }
+
+    // Bumped by every Seed; owners of their own Rng reseed when it changes
+    static uint32_t Generation() { return generation.load(std::memory_order_acquire); }
+
+    static Rng& Local() {
+        thread_local Rng rng;
+        thread_local uint32_t seenGeneration = 0;
+        uint32_t current = generation.load(std::memory_order_acquire);
+        if (seenGeneration != current) {
+            uint64_t stream = static_cast<uint64_t>(JobSystem::CurrentWorker() + 1);
+            rng.Seed(seed.load(std::memory_order_relaxed) ^ (stream * 0xd1342543de82ef95ull));
+            seenGeneration = current;
+        }
+        return rng;
+    }
+};
+
+// Component system
+struct Component {
+    virtual ~Component() = default;
+};
+
+// Component type ids
+using ComponentId = uint32_t;
+using ComponentMask = uint64_t;
+constexpr ComponentId MaxComponentTypes = sizeof(ComponentMask) * CHAR_BIT;
+
+class ComponentTypes {
+private:
+    static ComponentId Next() {
+        static ComponentId next = 0;
+        assert(next < MaxComponentTypes && "too many component types for ComponentMask");
+        return next++;
+    }
+
+    static std::unordered_map<std::string, ComponentId>& Aliases() {
+        static std::unordered_map<std::string, ComponentId> aliases;
+        return aliases;
+    }
+
+public:
+    // Each component type gets a small dense id on first use; lookups by
+    // type are an array index and a mask test, never a string hash.
+    template<typename T>
+    static ComponentId Id() {
+        static const ComponentId id = Next();
+        return id;
+    }
+
+    template<typename T>
+    static ComponentMask Mask() {
+        return ComponentMask{1} << Id<T>();
+    }
+
+    // Optional name -> type alias table for tools and legacy string lookups.
+    static void Alias(const std::string& name, ComponentId id) {
+        Aliases()[name] = id;
+    }
+
+    static bool Find(const std::string& name, ComponentId& id) {
+        auto it = Aliases().find(name);
+        if (it == Aliases().end()) return false;
+        id = it->second;
+        return true;
+    }
+};
+
+// Entity handles and component storage
+class Entity;
+
+// Interned entity tags. Tag strings map to small dense ids once, at
+// AddEntity time; per-frame tag queries never hash a string.
+using TagId = uint32_t;
+
+class Tags {
+private:
+    struct Table {
+        std::unordered_map<std::string, TagId> ids;
+        std::vector<std::string> names{""};
+    };
+
+    static Table& Get() {
+        static Table table;
+        return table;
+    }
+
+public:
+    static constexpr TagId None = 0;
+
+    static TagId Intern(const std::string& name) {
+        if (name.empty()) return None;
+        Table& table = Get();
+        auto it = table.ids.find(name);
+        if (it != table.ids.end()) return it->second;
+        TagId id = static_cast<TagId>(table.names.size());
+        table.ids.emplace(name, id);
+        table.names.push_back(name);
+        return id;
+    }
+
+    // Looks a tag up without interning it; unknown names yield None.
+    static TagId Find(const std::string& name) {
+        Table& table = Get();
+        auto it = table.ids.find(name);
+        return it == table.ids.end() ? None : it->second;
+    }
+
+    static const std::string& Name(TagId id) {
+        return Get().names[id];
+    }
+};
+
+// Non-owning view over a contiguous run of entity pointers. Valid until the
+// next Scene::Update or AddEntity.
+class EntityRange {
+private:
+    Entity* const* first = nullptr;
+    Entity* const* last = nullptr;
+
+public:
+    EntityRange() = default;
+    EntityRange(Entity* const* begin, Entity* const* end) : first(begin), last(end) {}
+
+    Entity* const* begin() const { return first; }
+    Entity* const* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+    Entity& operator[](size_t i) const { return *first[i]; }
+};
+
+
+struct EntityId {
+    static constexpr uint32_t InvalidIndex = UINT32_MAX;
+
+    uint32_t index = InvalidIndex;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return index != InvalidIndex; }
+    bool operator==(const EntityId& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const EntityId& other) const { return !(*this == other); }
+};
+
+class ComponentPoolBase {
+public:
+    virtual ~ComponentPoolBase() = default;
+    virtual bool Has(uint32_t index) const = 0;
+    virtual void Remove(uint32_t index) = 0;
+    virtual size_t Size() const = 0;
+    virtual uint32_t OwnerAt(size_t i) const = 0;
+};
+
+// Sparse set: components of one type live contiguously in `dense`,
+// `sparse` maps an entity slot index to its position in `dense`.
+// Pointers returned by Get are valid until the next Insert/Remove on this pool.
+template<typename T>
+class ComponentPool : public ComponentPoolBase {
+private:
+    static constexpr uint32_t Empty = UINT32_MAX;
+
+    std::vector<T> dense;
+    std::vector<uint32_t> owners;
+    std::vector<uint32_t> sparse;
+
+public:
+    bool Has(uint32_t index) const override {
+        return index < sparse.size() && sparse[index] != Empty;
+    }
+
+    T* Get(uint32_t index) {
+        return Has(index) ? &dense[sparse[index]] : nullptr;
+    }
+
+    T& Insert(uint32_t index, T value) {
+        if (Has(index)) {
+            dense[sparse[index]] = std::move(value);
+            return dense[sparse[index]];
+        }
+        if (index >= sparse.size()) {
+            sparse.resize(index + 1, Empty);
+        }
+        sparse[index] = static_cast<uint32_t>(dense.size());
+        dense.push_back(std::move(value));
+        owners.push_back(index);
+        return dense.back();
+    }
+
+    void Remove(uint32_t index) override {
+        if (!Has(index)) return;
+        uint32_t slot = sparse[index];
+        uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+        if (slot != last) {
+            dense[slot] = std::move(dense[last]);
+            owners[slot] = owners[last];
+            sparse[owners[slot]] = slot;
+        }
+        dense.pop_back();
+        owners.pop_back();
+        sparse[index] = Empty;
+    }
+
+    size_t Size() const override { return dense.size(); }
+    uint32_t OwnerAt(size_t i) const override { return owners[i]; }
+    T& At(size_t i) { return dense[i]; }
+
+    typename std::vector<T>::iterator begin() { return dense.begin(); }
+    typename std::vector<T>::iterator end() { return dense.end(); }
+};
+
+class Registry {
+private:
+    struct Slot {
+        Entity* entity = nullptr;
+        uint32_t generation = 0;
+        ComponentMask mask = 0;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<std::unique_ptr<ComponentPoolBase>> pools;
+
+public:
+    EntityId Create(Entity* entity) {
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        slots[index].entity = entity;
+        return EntityId{index, slots[index].generation};
+    }
+
+    void Destroy(EntityId id) {
+        if (!IsAlive(id)) return;
+        Slot& slot = slots[id.index];
+        for (ComponentId type = 0; slot.mask != 0; type++, slot.mask >>= 1) {
+            if (slot.mask & 1) pools[type]->Remove(id.index);
+        }
+        slots[id.index].entity = nullptr;
+        slots[id.index].generation++;
+        freeSlots.push_back(id.index);
+    }
+
+    bool IsAlive(EntityId id) const {
+        return id.index < slots.size() &&
+               slots[id.index].generation == id.generation &&
+               slots[id.index].entity != nullptr;
+    }
+
+    Entity* Get(EntityId id) const {
+        return IsAlive(id) ? slots[id.index].entity : nullptr;
+    }
+
+    Entity* GetByIndex(uint32_t index) const {
+        return index < slots.size() ? slots[index].entity : nullptr;
+    }
+
+    template<typename T>
+    ComponentPool<T>* Pool() {
+        ComponentId type = ComponentTypes::Id<T>();
+        if (type >= pools.size()) return nullptr;
+        return static_cast<ComponentPool<T>*>(pools[type].get());
+    }
+
+    template<typename T>
+    ComponentPool<T>& Assure() {
+        ComponentId type = ComponentTypes::Id<T>();
+        if (type >= pools.size()) pools.resize(type + 1);
+        if (!pools[type]) pools[type] = std::make_unique<ComponentPool<T>>();
+        return *static_cast<ComponentPool<T>*>(pools[type].get());
+    }
+
+    ComponentMask GetMask(EntityId id) const {
+        return IsAlive(id) ? slots[id.index].mask : 0;
+    }
+
+    template<typename T>
+    T& AddComponent(EntityId id, T component) {
+        slots[id.index].mask |= ComponentTypes::Mask<T>();
+        return Assure<T>().Insert(id.index, std::move(component));
+    }
+
+    template<typename T>
+    bool HasComponent(EntityId id) const {
+        return (GetMask(id) & ComponentTypes::Mask<T>()) != 0;
+    }
+
+    template<typename T>
+    T* GetComponent(EntityId id) {
+        if (!HasComponent<T>(id)) return nullptr;
+        return static_cast<ComponentPool<T>*>(pools[ComponentTypes::Id<T>()].get())->Get(id.index);
+    }
+
+    template<typename T>
+    void RemoveComponent(EntityId id) {
+        if (!HasComponent<T>(id)) return;
+        slots[id.index].mask &= ~ComponentTypes::Mask<T>();
+        Pool<T>()->Remove(id.index);
+    }
+
+    // Calls fn(Entity&, Ts&...) for every entity owning all of Ts.
+    // Iteration is driven by the smallest of the involved pools.
+    template<typename... Ts, typename Fn>
+    void Each(Fn&& fn) {
+        auto typed = std::make_tuple(Pool<Ts>()...);
+        ComponentPoolBase* candidates[] = { Pool<Ts>()... };
+        ComponentPoolBase* driver = nullptr;
+        for (auto* pool : candidates) {
+            if (!pool) return;
+            if (!driver || pool->Size() < driver->Size()) driver = pool;
+        }
+        const ComponentMask required = (ComponentTypes::Mask<Ts>() | ...);
+        for (size_t i = driver->Size(); i-- > 0;) {
+            uint32_t owner = driver->OwnerAt(i);
+            Entity* entity = slots[owner].entity;
+            if (!entity) continue;
+            if ((slots[owner].mask & required) == required) {
+                fn(*entity, *std::get<ComponentPool<Ts>*>(typed)->Get(owner)...);
+            }
+        }
+    }
+};
+
+// Normalized texture coordinates of a sprite's corners
+struct UVRect {
+    float u0, v0, u1, v1;
+};
+
+// Batched renderer. Quads are collected into per-(layer, texture) vertex
+// buffers during the frame and submitted through rlgl on Flush, one
+// rlBegin/rlEnd run per bucket, so draw calls scale with the number of
+// distinct textures instead of the number of objects.
+class RenderBatch {
+public:
+    struct Vertex {
+        float x, y;
+        float u, v;
+        Color color;
+    };
+
+    struct Stats {
+        size_t quads = 0;
+        size_t drawCalls = 0;
+    };
+
+    // Default layers used by Scene::Draw
+    static constexpr int ParticleLayer = 0;
+    static constexpr int EntityLayer = 1;
+
+private:
+    struct Bucket {
+        int layer;
+        unsigned int textureId;
+        std::vector<Vertex> vertices;
+    };
+
+    // Quads per rlBegin/rlEnd run, kept well under rlgl's default batch size
+    static constexpr size_t QuadsPerRun = 1024;
+    static constexpr int CircleTextureSize = 64;
+
+    // Ids used for bucketing by the null renderer, which has no GL textures
+    static constexpr unsigned int NullDefaultTexture = 1;
+    static constexpr unsigned int NullCircleTexture = 2;
+
+    std::vector<Bucket> buckets;
+    size_t lastBucket = 0;
+    std::vector<size_t> order;
+    Texture2D circleTexture{};
+    bool circleTextureLoaded = false;
+#ifdef GAME_ENGINE_HEADLESS
+    static constexpr bool nullRenderer = true;
+#else
+    bool nullRenderer = false;
+#endif
+    Stats lastStats;
+
+    std::vector<Vertex>& BucketFor(int layer, unsigned int textureId) {
+        // Consecutive draws usually share a bucket
+        if (lastBucket < buckets.size()) {
+            Bucket& last = buckets[lastBucket];
+            if (last.layer == layer && last.textureId == textureId) return last.vertices;
+        }
+        for (size_t i = 0; i < buckets.size(); i++) {
+            if (buckets[i].layer == layer && buckets[i].textureId == textureId) {
+                lastBucket = i;
+                return buckets[i].vertices;
+            }
+        }
+        lastBucket = buckets.size();
+        buckets.push_back(Bucket{layer, textureId, {}});
+        return buckets.back().vertices;
+    }
+
+    // Same transform as DrawTexturePro: dest.x/y is the pivot, origin is
+    // relative to the quad's top-left corner, rotation is in degrees.
+    static void PushQuad(std::vector<Vertex>& out, Rectangle dest, Vector2 origin, float rotation,
+                         float u0, float v0, float u1, float v1, Color tint) {
+        float x0 = -origin.x, y0 = -origin.y;
+        float x1 = x0 + dest.width, y1 = y0 + dest.height;
+        float c = 1.0f, s = 0.0f;
+        if (rotation != 0.0f) {
+            c = cosf(rotation * DEG2RAD);
+            s = sinf(rotation * DEG2RAD);
+        }
+        auto corner = [&](float x, float y, float u, float v) {
+            out.push_back(Vertex{dest.x + x * c - y * s, dest.y + x * s + y * c, u, v, tint});
+        };
+        corner(x0, y0, u0, v0);
+        corner(x0, y1, u0, v1);
+        corner(x1, y1, u1, v1);
+        corner(x1, y0, u1, v0);
+    }
+
+    unsigned int DefaultTextureId() const {
+#ifdef GAME_ENGINE_HEADLESS
+        return NullDefaultTexture;
+#else
+        return nullRenderer ? NullDefaultTexture : rlGetTextureIdDefault();
+#endif
+    }
+
+    unsigned int CircleTextureId() {
+#ifdef GAME_ENGINE_HEADLESS
+        return NullCircleTexture;
+#else
+        if (nullRenderer) return NullCircleTexture;
+        EnsureCircleTexture();
+        return circleTexture.id;
+#endif
+    }
+
+#ifndef GAME_ENGINE_HEADLESS
+    void EnsureCircleTexture() {
+        if (circleTextureLoaded) return;
+        Image image = GenImageColor(CircleTextureSize, CircleTextureSize, BLANK);
+        ImageDrawCircle(&image, CircleTextureSize / 2, CircleTextureSize / 2, CircleTextureSize / 2 - 1, WHITE);
+        circleTexture = LoadTextureFromImage(image);
+        UnloadImage(image);
+        circleTextureLoaded = true;
+    }
+#endif
+
+public:
+    // Layers are drawn in ascending order; within a layer, grouping by texture
+    // means submission order between different textures is not preserved.
+    void DrawQuad(Rectangle dest, Vector2 origin, float rotation, Color tint, int layer = 0) {
+        PushQuad(BucketFor(layer, DefaultTextureId()), dest, origin, rotation,
+                 0.0f, 0.0f, 1.0f, 1.0f, tint);
+    }
+
+    void DrawSprite(Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin,
+                    float rotation, Color tint, int layer = 0) {
+        if (texture.id == 0 || texture.width == 0 || texture.height == 0) return;
+        float u0 = source.x / texture.width;
+        float v0 = source.y / texture.height;
+        float u1 = (source.x + source.width) / texture.width;
+        float v1 = (source.y + source.height) / texture.height;
+        PushQuad(BucketFor(layer, texture.id), dest, origin, rotation, u0, v0, u1, v1, tint);
+    }
+
+    // For UVs resolved ahead of time, e.g. atlas frames
+    void DrawSpriteUV(Texture2D texture, UVRect uv, Rectangle dest, Vector2 origin,
+                      float rotation, Color tint, int layer = 0) {
+        if (texture.id == 0) return;
+        PushQuad(BucketFor(layer, texture.id), dest, origin, rotation, uv.u0, uv.v0, uv.u1, uv.v1, tint);
+    }
+
+    void DrawCircle(Vector2 center, float radius, Color tint, int layer = 0) {
+        PushQuad(BucketFor(layer, CircleTextureId()),
+                 Rectangle{center.x, center.y, radius * 2, radius * 2},
+                 Vector2{radius, radius}, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, tint);
+    }
+
+    void Flush() {
+        order.clear();
+        for (size_t i = 0; i < buckets.size(); i++) {
+            if (!buckets[i].vertices.empty()) order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            if (buckets[a].layer != buckets[b].layer) return buckets[a].layer < buckets[b].layer;
+            return buckets[a].textureId < buckets[b].textureId;
+        });
+
+        Stats stats;
+        for (size_t index : order) {
+            auto& bucket = buckets[index];
+            size_t quadCount = bucket.vertices.size() / 4;
+            stats.quads += quadCount;
+            for (size_t first = 0; first < quadCount; first += QuadsPerRun) {
+                stats.drawCalls++;
+                if (nullRenderer) continue;
+#ifndef GAME_ENGINE_HEADLESS
+                size_t last = std::min(quadCount, first + QuadsPerRun);
+                rlCheckRenderBatchLimit(static_cast<int>((last - first) * 4));
+                rlSetTexture(bucket.textureId);
+                rlBegin(RL_QUADS);
+                rlNormal3f(0.0f, 0.0f, 1.0f);
+                for (size_t v = first * 4; v < last * 4; v++) {
+                    const Vertex& vertex = bucket.vertices[v];
+                    rlColor4ub(vertex.color.r, vertex.color.g, vertex.color.b, vertex.color.a);
+                    rlTexCoord2f(vertex.u, vertex.v);
+                    rlVertex2f(vertex.x, vertex.y);
+                }
+                rlEnd();
+#endif
+            }
+            // Keep the buffer's capacity for the next frame
+            bucket.vertices.clear();
+        }
+#ifndef GAME_ENGINE_HEADLESS
+        if (!nullRenderer) rlSetTexture(0);
+#endif
+        lastStats = stats;
+    }
+
+    // The null renderer batches and counts as usual but submits nothing,
+    // for running without a GL context. Always on in headless builds.
+    void SetNullRenderer(bool enabled) {
+#ifndef GAME_ENGINE_HEADLESS
+        nullRenderer = enabled;
+#else
+        (void)enabled;
+#endif
+    }
+
+    bool IsNullRenderer() const { return nullRenderer; }
+
+    // Must be called while the GL context is still alive
+    void Unload() {
+#ifndef GAME_ENGINE_HEADLESS
+        if (circleTextureLoaded) {
+            UnloadTexture(circleTexture);
+            circleTextureLoaded = false;
+        }
+#endif
+    }
+
+    const Stats& GetStats() const { return lastStats; }
+};
+
+// Animation component
+// Skyline bottom-left rectangle packer. The top edge of the packed area is
+// kept as a list of horizontal segments; each rectangle goes where its top
+// ends up lowest, ties going to the narrowest segment.
+class RectPacker {
+private:
+    struct Segment {
+        int x, y, width;
+    };
+
+    int width;
+    int height;
+    std::vector<Segment> skyline;
+
+    // Bottom of a w x h rectangle whose left edge sits at segment i, or -1
+    int FitAt(size_t i, int w, int h) const {
+        if (skyline[i].x + w > width) return -1;
+        int y = 0;
+        for (size_t j = i, remaining = 0; remaining < static_cast<size_t>(w); j++) {
+            y = std::max(y, skyline[j].y);
+            if (y + h > height) return -1;
+            remaining += skyline[j].width;
+        }
+        return y;
+    }
+
+public:
+    RectPacker(int packWidth, int packHeight)
+        : width(packWidth), height(packHeight), skyline{Segment{0, 0, packWidth}} {}
+
+    bool Insert(int w, int h, int& outX, int& outY) {
+        if (w <= 0 || h <= 0) return false;
+        size_t best = SIZE_MAX;
+        int bestTop = INT_MAX, bestWidth = INT_MAX, bestY = 0;
+        for (size_t i = 0; i < skyline.size(); i++) {
+            int y = FitAt(i, w, h);
+            if (y < 0) continue;
+            if (y + h < bestTop || (y + h == bestTop && skyline[i].width < bestWidth)) {
+                best = i;
+                bestTop = y + h;
+                bestWidth = skyline[i].width;
+                bestY = y;
+            }
+        }
+        if (best == SIZE_MAX) return false;
+
+        Segment placed{skyline[best].x, bestY + h, w};
+        skyline.insert(skyline.begin() + best, placed);
+        // Trim the segments now covered by the new one
+        for (size_t i = best + 1; i < skyline.size();) {
+            int covered = placed.x + placed.width - skyline[i].x;
+            if (covered <= 0) break;
+            if (covered < skyline[i].width) {
+                skyline[i].x += covered;
+                skyline[i].width -= covered;
+                break;
+            }
+            skyline.erase(skyline.begin() + i);
+        }
+        for (size_t i = 0; i + 1 < skyline.size();) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+        outX = placed.x;
+        outY = bestY;
+        return true;
+    }
+};
+
+// A sprite sheet packed into an atlas page. Frames form a row-major grid
+// over the sheet; their UVs are resolved once when the atlas is built.
+struct AtlasSprite {
+    Texture2D texture{};
+    Rectangle rect{}; // Pixels on the page
+    Vector2 frameSize{};
+    std::vector<UVRect> frames;
+};
+
+#ifndef GAME_ENGINE_HEADLESS
+// Packs sprite sheets into a few large textures at load time, so sprites
+// from different sheets land in one RenderBatch bucket. Build() can cache
+// the result on disk (page PNGs plus a small layout file) and reuses it
+// while the sheet list, page size and the sheet files' sizes are unchanged,
+// skipping the decode and pack.
+class TextureAtlas {
+private:
+    struct Source {
+        std::string name;
+        std::string path;
+        int frameWidth;
+        int frameHeight;
+    };
+
+    struct Placement {
+        int page = -1;
+        int x = 0, y = 0, width = 0, height = 0;
+    };
+
+    int pageSize;
+    int padding;
+    std::vector<Source> sources;
+    std::unordered_map<std::string, AtlasSprite> sprites;
+    std::vector<Texture2D> pages;
+
+    static long long FileSize(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        return file ? static_cast<long long>(file.tellg()) : -1;
+    }
+
+    // FNV-1a over everything that affects the packed result
+    uint64_t CacheKey() const {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&](const std::string& text) {
+            for (unsigned char c : text) {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            hash ^= 0xff;
+            hash *= 1099511628211ull;
+        };
+        mix(std::to_string(pageSize) + " " + std::to_string(padding));
+        for (const auto& source : sources) {
+            mix(source.name);
+            mix(source.path);
+            mix(std::to_string(source.frameWidth) + " " + std::to_string(source.frameHeight) + " " +
+                std::to_string(FileSize(source.path)));
+        }
+        return hash;
+    }
+
+    static std::string PagePath(const std::string& cachePath, size_t page) {
+        return cachePath + ".page" + std::to_string(page) + ".png";
+    }
+
+    void AddSprite(const Source& source, const Placement& placement) {
+        AtlasSprite& sprite = sprites[source.name];
+        sprite.texture = pages[placement.page];
+        sprite.rect = Rectangle{static_cast<float>(placement.x), static_cast<float>(placement.y),
+                                static_cast<float>(placement.width), static_cast<float>(placement.height)};
+        int frameWidth = source.frameWidth > 0 ? source.frameWidth : placement.width;
+        int frameHeight = source.frameHeight > 0 ? source.frameHeight : placement.height;
+        int columns = std::max(1, placement.width / frameWidth);
+        int rows = std::max(1, placement.height / frameHeight);
+        float scale = 1.0f / static_cast<float>(pageSize);
+        sprite.frameSize = Vector2{static_cast<float>(frameWidth), static_cast<float>(frameHeight)};
+        sprite.frames.clear();
+        for (int row = 0; row < rows; row++) {
+            for (int column = 0; column < columns; column++) {
+                float x = static_cast<float>(placement.x + column * frameWidth);
+                float y = static_cast<float>(placement.y + row * frameHeight);
+                sprite.frames.push_back(UVRect{x * scale, y * scale,
+                                               (x + frameWidth) * scale, (y + frameHeight) * scale});
+            }
+        }
+    }
+
+    bool LoadCache(const std::string& cachePath, uint64_t key) {
+        std::ifstream file(cachePath);
+        std::string magic;
+        uint64_t storedKey = 0;
+        size_t pageCount = 0;
+        if (!(file >> magic >> std::hex >> storedKey >> std::dec >> pageCount) ||
+            magic != "atlas" || storedKey != key) {
+            return false;
+        }
+
+        std::unordered_map<std::string, Placement> placements;
+        std::string name;
+        Placement placement;
+        while (file >> std::quoted(name) >> placement.page >> placement.x >> placement.y
+                    >> placement.width >> placement.height) {
+            if (placement.page < 0 || static_cast<size_t>(placement.page) >= pageCount) return false;
+            placements[name] = placement;
+        }
+        for (const auto& source : sources) {
+            if (!placements.count(source.name)) return false;
+        }
+        for (size_t page = 0; page < pageCount; page++) {
+            if (!FileExists(PagePath(cachePath, page).c_str())) return false;
+        }
+
+        for (size_t page = 0; page < pageCount; page++) {
+            pages.push_back(LoadTexture(PagePath(cachePath, page).c_str()));
+        }
+        for (const auto& source : sources) AddSprite(source, placements[source.name]);
+        return true;
+    }
+
+    bool Pack(const std::string& cachePath, uint64_t key) {
+        std::vector<Image> images(sources.size());
+        auto unloadAll = [&]() {
+            for (auto& image : images) {
+                if (image.data) UnloadImage(image);
+            }
+        };
+        for (size_t i = 0; i < sources.size(); i++) {
+            images[i] = LoadImage(sources[i].path.c_str());
+            if (!images[i].data || images[i].width + padding > pageSize || images[i].height + padding > pageSize) {
+                unloadAll();
+                return false;
+            }
+            ImageFormat(&images[i], PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+        }
+
+        // Tallest first packs tightest with a skyline
+        std::vector<size_t> order(sources.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            if (images[a].height != images[b].height) return images[a].height > images[b].height;
+            return images[a].width > images[b].width;
+        });
+
+        std::vector<RectPacker> packers;
+        std::vector<Placement> placements(sources.size());
+        for (size_t i : order) {
+            Placement& placement = placements[i];
+            placement.width = images[i].width;
+            placement.height = images[i].height;
+            for (size_t page = 0; page < packers.size() && placement.page < 0; page++) {
+                if (packers[page].Insert(placement.width + padding, placement.height + padding,
+                                         placement.x, placement.y)) {
+                    placement.page = static_cast<int>(page);
+                }
+            }
+            if (placement.page < 0) {
+                packers.emplace_back(pageSize, pageSize);
+                packers.back().Insert(placement.width + padding, placement.height + padding,
+                                      placement.x, placement.y);
+                placement.page = static_cast<int>(packers.size() - 1);
+            }
+        }
+
+        for (size_t page = 0; page < packers.size(); page++) {
+            Image pageImage = GenImageColor(pageSize, pageSize, BLANK);
+            for (size_t i = 0; i < sources.size(); i++) {
+                const Placement& placement = placements[i];
+                if (placement.page != static_cast<int>(page)) continue;
+                Rectangle rect{static_cast<float>(placement.x), static_cast<float>(placement.y),
+                               static_cast<float>(placement.width), static_cast<float>(placement.height)};
+                ImageDraw(&pageImage, images[i], Rectangle{0, 0, rect.width, rect.height}, rect, WHITE);
+            }
+            pages.push_back(LoadTextureFromImage(pageImage));
+            if (!cachePath.empty()) ExportImage(pageImage, PagePath(cachePath, page).c_str());
+            UnloadImage(pageImage);
+        }
+        unloadAll();
+
+        for (size_t i = 0; i < sources.size(); i++) AddSprite(sources[i], placements[i]);
+
+        if (!cachePath.empty()) {
+            std::ofstream file(cachePath);
+            file << "atlas " << std::hex << key << std::dec << " " << pages.size() << "\n";
+            for (size_t i = 0; i < sources.size(); i++) {
+                const Placement& p = placements[i];
+                file << std::quoted(sources[i].name) << " " << p.page << " " << p.x << " " << p.y
+                     << " " << p.width << " " << p.height << "\n";
+            }
+        }
+        return true;
+    }
+
+public:
+    explicit TextureAtlas(int atlasPageSize = 2048, int spritePadding = 2)
+        : pageSize(atlasPageSize), padding(spritePadding) {}
+
+    ~TextureAtlas() { Unload(); }
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    // frameWidth/frameHeight of 0 treat the whole sheet as one frame
+    void AddSheet(const std::string& name, const std::string& path, int frameWidth = 0, int frameHeight = 0) {
+        sources.push_back(Source{name, path, frameWidth, frameHeight});
+    }
+
+    // Packs every added sheet (or loads the cached pages). Needs a GL
+    // context. Fails if a sheet can't be loaded or doesn't fit on a page.
+    bool Build(const std::string& cachePath = "") {
+        Unload();
+        uint64_t key = CacheKey();
+        if (!cachePath.empty() && LoadCache(cachePath, key)) return true;
+        Unload();
+        return Pack(cachePath, key);
+    }
+
+    // Stable until the next Build or Unload
+    const AtlasSprite* Find(const std::string& name) const {
+        auto it = sprites.find(name);
+        return it != sprites.end() ? &it->second : nullptr;
+    }
+
+    size_t PageCount() const { return pages.size(); }
+
+    // Must be called while the GL context is still alive
+    void Unload() {
+        for (auto& page : pages) UnloadTexture(page);
+        pages.clear();
+        sprites.clear();
+    }
+};
+#endif
+
+// Asynchronous texture loading. LoadTexture returns at once with a handle;
+// a background thread reads and decodes the file, and Update (run by
+// GameEngine at the start of every frame) uploads finished images to the
+// GPU within a time budget. Until then a handle draws as a 1x1 white
+// placeholder, i.e. a flat quad in the entity's color. Loads are
+// deduplicated by path and reference counted: the texture is unloaded when
+// the last handle to it goes away. Handles, LoadTexture and Update belong
+// to the main thread.
+class TextureHandle {
+private:
+    static constexpr uint32_t Invalid = UINT32_MAX;
+
+    uint32_t slot = Invalid;
+    uint32_t generation = 0;
+
+    friend class ResourceManager;
+    TextureHandle(uint32_t slotIndex, uint32_t slotGeneration) : slot(slotIndex), generation(slotGeneration) {}
+
+public:
+    TextureHandle() = default;
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other) noexcept : slot(other.slot), generation(other.generation) {
+        other.slot = Invalid;
+    }
+    TextureHandle& operator=(const TextureHandle& other);
+    TextureHandle& operator=(TextureHandle&& other) noexcept;
+    ~TextureHandle() { Reset(); }
+
+    void Reset();
+
+    // The texture, or the placeholder while loading or after a failed load
+    Texture2D Get() const;
+    bool IsReady() const;
+    bool Failed() const;
+    explicit operator bool() const { return slot != Invalid; }
+};
+
+class ResourceManager {
+public:
+    enum class Status : uint8_t { Loading, Ready, Failed };
+
+private:
+#ifndef GAME_ENGINE_HEADLESS
+    using Pixels = Image;
+#else
+    // No decoder without raylib: the file is only read, for the I/O cost
+    struct Pixels {
+        std::vector<uint8_t> bytes;
+    };
+#endif
+
+    struct Slot {
+        std::string path;
+        Texture2D texture{};
+        uint32_t refs = 0;
+        uint32_t generation = 0;
+        Status status = Status::Loading;
+    };
+
+    struct Request {
+        std::string path;
+        uint32_t slot;
+        uint32_t generation;
+    };
+
+    struct Result {
+        uint32_t slot;
+        uint32_t generation;
+        bool ok;
+        Pixels pixels;
+    };
+
+    struct State {
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+        std::unordered_map<std::string, uint32_t> byPath;
+        Texture2D placeholder{};
+        bool nullRenderer = false;
+        unsigned int nextFakeId = 1u << 20;
+        size_t inFlight = 0; // Requested and not yet uploaded or discarded
+
+        // Shared with the loader thread
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::deque<Request> requests;
+        std::deque<Result> results;
+        bool stop = false;
+        std::thread loader;
+
+        ~State() { StopLoader(*this); }
+    };
+
+    static State& Get() {
+        static State state;
+        return state;
+    }
+
+    static bool Decode(const std::string& path, Pixels& pixels) {
+#ifndef GAME_ENGINE_HEADLESS
+        pixels = LoadImage(path.c_str());
+        return pixels.data != nullptr;
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        pixels.bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(pixels.bytes.data()), pixels.bytes.size()));
+#endif
+    }
+
+    static void FreePixels([[maybe_unused]] Pixels& pixels) {
+#ifndef GAME_ENGINE_HEADLESS
+        if (pixels.data) UnloadImage(pixels);
+        pixels.data = nullptr;
+#endif
+    }
+
+    static Texture2D Upload(State& state, Pixels& pixels) {
+        Texture2D texture{};
+#ifndef GAME_ENGINE_HEADLESS
+        if (!state.nullRenderer) {
+            texture = LoadTextureFromImage(pixels);
+        } else {
+            texture = Texture2D{state.nextFakeId++, pixels.width, pixels.height, 1, pixels.format};
+        }
+#else
+        // Size from the PNG header when there is one, so the null renderer
+        // sees sensible UVs
+        const auto& b = pixels.bytes;
+        auto be32 = [&b](size_t at) {
+            return static_cast<int>((uint32_t{b[at]} << 24) | (uint32_t{b[at + 1]} << 16) |
+                                    (uint32_t{b[at + 2]} << 8) | b[at + 3]);
+        };
+        bool png = b.size() >= 24 && std::memcmp(b.data(), "\x89PNG", 4) == 0;
+        texture = Texture2D{state.nextFakeId++, png ? be32(16) : 1, png ? be32(20) : 1, 1, 0};
+#endif
+        FreePixels(pixels);
+        return texture;
+    }
+
+    static void Unload([[maybe_unused]] State& state, [[maybe_unused]] Texture2D& texture) {
+#ifndef GAME_ENGINE_HEADLESS
+        if (!state.nullRenderer && texture.id != 0) UnloadTexture(texture);
+#endif
+        texture = Texture2D{};
+    }
+
+    static void LoaderLoop(State& state) {
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while (true) {
+            state.wake.wait(lock, [&] { return state.stop || !state.requests.empty(); });
+            if (state.stop) return;
+            Request request = std::move(state.requests.front());
+            state.requests.pop_front();
+            lock.unlock();
+            Result result{request.slot, request.generation, false, Pixels{}};
+            result.ok = Decode(request.path, result.pixels);
+            lock.lock();
+            state.results.push_back(std::move(result));
+            state.done.notify_all();
+        }
+    }
+
+    static void StopLoader(State& state) {
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.stop = true;
+        }
+        state.wake.notify_all();
+        if (state.loader.joinable()) state.loader.join();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (auto& result : state.results) FreePixels(result.pixels);
+        state.results.clear();
+        state.requests.clear();
+        state.inFlight = 0;
+        state.stop = false;
+    }
+
+    static bool IsCurrent(const State& state, uint32_t slot, uint32_t generation) {
+        return slot < state.slots.size() && state.slots[slot].generation == generation &&
+               state.slots[slot].refs > 0;
+    }
+
+    friend class TextureHandle;
+
+    static void AddRef(uint32_t slot, uint32_t generation) {
+        State& state = Get();
+        if (IsCurrent(state, slot, generation)) state.slots[slot].refs++;
+    }
+
+    static void Release(uint32_t slot, uint32_t generation) {
+        State& state = Get();
+        if (!IsCurrent(state, slot, generation)) return;
+        Slot& entry = state.slots[slot];
+        if (--entry.refs > 0) return;
+        // A load still in flight is discarded when its result arrives
+        Unload(state, entry.texture);
+        state.byPath.erase(entry.path);
+        entry.path.clear();
+        entry.generation++;
+        state.freeSlots.push_back(slot);
+    }
+
+    static const Slot* Find(uint32_t slot, uint32_t generation) {
+        State& state = Get();
+        return IsCurrent(state, slot, generation) ? &state.slots[slot] : nullptr;
+    }
+
+    // Without a GPU the placeholder gets a fake id like any other texture,
+    // so batches still record its quads
+    static Texture2D Placeholder(State& state) {
+        if (state.placeholder.id != 0) return state.placeholder;
+#ifndef GAME_ENGINE_HEADLESS
+        if (!state.nullRenderer) {
+            Image white = GenImageColor(1, 1, WHITE);
+            state.placeholder = LoadTextureFromImage(white);
+            UnloadImage(white);
+            return state.placeholder;
+        }
+#endif
+        state.placeholder = Texture2D{state.nextFakeId++, 1, 1, 1, 0};
+        return state.placeholder;
+    }
+
+    // Uploads one finished decode; returns false if there was none
+    static bool UploadOne(State& state) {
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (state.results.empty()) return false;
+            result = std::move(state.results.front());
+            state.results.pop_front();
+        }
+        state.inFlight--;
+        if (!IsCurrent(state, result.slot, result.generation)) {
+            FreePixels(result.pixels);
+            return true;
+        }
+        Slot& entry = state.slots[result.slot];
+        if (result.ok) {
+            entry.texture = Upload(state, result.pixels);
+            entry.status = Status::Ready;
+        } else {
+            entry.status = Status::Failed;
+        }
+        return true;
+    }
+
+public:
+    // Queues a load, or shares the existing one for the same path
+    static TextureHandle LoadTexture(const std::string& path) {
+        State& state = Get();
+        auto found = state.byPath.find(path);
+        if (found != state.byPath.end()) {
+            Slot& entry = state.slots[found->second];
+            entry.refs++;
+            return TextureHandle(found->second, entry.generation);
+        }
+
+        uint32_t slot;
+        if (!state.freeSlots.empty()) {
+            slot = state.freeSlots.back();
+            state.freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(state.slots.size());
+            state.slots.emplace_back();
+        }
+        Slot& entry = state.slots[slot];
+        entry.path = path;
+        entry.refs = 1;
+        entry.status = Status::Loading;
+        entry.texture = Texture2D{};
+        state.byPath.emplace(path, slot);
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (!state.loader.joinable()) state.loader = std::thread(LoaderLoop, std::ref(state));
+            state.requests.push_back(Request{path, slot, entry.generation});
+        }
+        state.inFlight++;
+        state.wake.notify_one();
+        return TextureHandle(slot, entry.generation);
+    }
+
+    // Uploads decoded textures until budgetMs has passed (at least one per
+    // call, so loading always makes progress). Returns how many finished.
+    static size_t Update(double budgetMs = 2.0) {
+        State& state = Get();
+        if (state.inFlight == 0) return 0;
+        PROFILE_ZONE("ResourceManager::Update");
+        auto start = std::chrono::steady_clock::now();
+        size_t finished = 0;
+        while (UploadOne(state)) {
+            finished++;
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budgetMs) break;
+        }
+        return finished;
+    }
+
+    // Blocks until every queued load has finished (loading screens, tests)
+    static void WaitAll() {
+        State& state = Get();
+        while (state.inFlight > 0) {
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.done.wait(lock, [&] { return !state.results.empty(); });
+            }
+            while (UploadOne(state)) {}
+        }
+    }
+
+    static size_t PendingCount() { return Get().inFlight; }
+
+    // Headless engines have no GL context: uploads then only hand out ids
+    static void SetNullRenderer(bool enabled) { Get().nullRenderer = enabled; }
+
+    // Unloads every texture and stops the loader thread. Handles still
+    // alive become placeholders. GameEngine calls this before closing its
+    // window; LoadTexture works again afterwards.
+    static void Shutdown() {
+        State& state = Get();
+        StopLoader(state);
+        for (uint32_t i = 0; i < state.slots.size(); i++) {
+            Slot& entry = state.slots[i];
+            if (entry.refs == 0) continue;
+            Unload(state, entry.texture);
+            entry.refs = 0;
+            entry.path.clear();
+            entry.generation++;
+            state.freeSlots.push_back(i);
+        }
+        state.byPath.clear();
+        Unload(state, state.placeholder);
+    }
+};
+
+inline TextureHandle::TextureHandle(const TextureHandle& other) : slot(other.slot), generation(other.generation) {
+    if (slot != Invalid) ResourceManager::AddRef(slot, generation);
+}
+
+inline TextureHandle& TextureHandle::operator=(const TextureHandle& other) {
+    if (this != &other) {
+        if (other.slot != Invalid) ResourceManager::AddRef(other.slot, other.generation);
+        Reset();
+        slot = other.slot;
+        generation = other.generation;
+    }
+    return *this;
+}
+
+inline TextureHandle& TextureHandle::operator=(TextureHandle&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        slot = other.slot;
+        generation = other.generation;
+        other.slot = Invalid;
+    }
+    return *this;
+}
+
+inline void TextureHandle::Reset() {
+    if (slot != Invalid) ResourceManager::Release(slot, generation);
+    slot = Invalid;
+}
+
+inline Texture2D TextureHandle::Get() const {
+    const auto* entry = ResourceManager::Find(slot, generation);
+    if (entry && entry->status == ResourceManager::Status::Ready) return entry->texture;
+    return ResourceManager::Placeholder(ResourceManager::Get());
+}
+
+inline bool TextureHandle::IsReady() const {
+    const auto* entry = ResourceManager::Find(slot, generation);
+    return entry && entry->status == ResourceManager::Status::Ready;
+}
+
+inline bool TextureHandle::Failed() const {
+    const auto* entry = ResourceManager::Find(slot, generation);
+    return entry && entry->status == ResourceManager::Status::Failed;
+}
+
+struct AnimationComponent : public Component {
+    Texture2D spriteSheet{};
+    // When set, drawn instead of spriteSheet (placeholder until loaded)
+    TextureHandle sheet;
+    Rectangle frameRect{};
+    float frameTime = 0;
+    float frameDuration = 0.1f;
+    int currentFrame = 0;
+    int frameCount = 1;
+    bool loop = true;
+    bool playing = true;
+    // Set by UseAtlas: frames are then drawn from the atlas's precomputed UVs
+    const AtlasSprite* atlasSprite = nullptr;
+
+    // Returns false and leaves the component unchanged for a sprite with no
+    // frames
+    bool UseAtlas(const AtlasSprite& sprite) {
+        if (sprite.frames.empty()) return false;
+        atlasSprite = &sprite;
+        spriteSheet = sprite.texture;
+        frameRect = Rectangle{0, 0, sprite.frameSize.x, sprite.frameSize.y};
+        frameCount = static_cast<int>(sprite.frames.size());
+        currentFrame = 0;
+        return true;
+    }
+
+    // Carries the leftover time into the next frame and skips as many
+    // frames as a long tick covers
+    void Update() {
+        if (!playing || frameDuration <= 0.0f || frameCount <= 0) return;
+
+        frameTime += DeltaTime::Get();
+        if (frameTime < frameDuration) return;
+        int advanced = static_cast<int>(frameTime / frameDuration);
+        frameTime -= advanced * frameDuration;
+        currentFrame += advanced;
+        if (currentFrame >= frameCount) {
+            if (loop) currentFrame %= frameCount;
+            else {
+                currentFrame = frameCount - 1;
+                frameTime = 0;
+                playing = false;
+            }
+        }
+        frameRect.x = frameRect.width * currentFrame;
+    }
+};
+
+// Shared, immutable animation data. Clips and state machines are
+// registered once (at load time, before any threads use them) and
+// referenced by small ids from any number of Animator instances.
+using ClipId = uint16_t;
+using MachineId = uint8_t;
+
+struct AnimationClip {
+    std::string name;
+    Texture2D texture{};
+    std::vector<Rectangle> frames; // Source rects on the texture
+    std::vector<UVRect> uvs;       // Atlas UVs; when set, used instead of frames
+    float frameDuration = 0.1f;
+    bool loop = true;
+};
+
+// States play clips; transitions fire on a parameter (trigger or flag) or
+// when a non-looping clip finishes. Transitions are checked in the order
+// they were added, and the first match wins.
+class AnimationStateMachine {
+public:
+    enum class Condition : uint8_t {
+        Trigger,   // Parameter bit set; the transition clears it
+        FlagSet,   // Parameter bit set
+        FlagClear, // Parameter bit clear
+        Finished   // Current clip reached its last frame (non-looping)
+    };
+
+    struct Transition {
+        uint8_t from;
+        uint8_t to;
+        Condition condition;
+        uint8_t parameter;
+    };
+
+    static constexpr uint8_t AnyState = 0xff;
+    static constexpr uint8_t NoParameter = 0xff;
+    // Bit 15 of Animator::flags is FinishedBit
+    static constexpr size_t MaxParameters = 15;
+
+    std::vector<std::string> stateNames;
+    std::vector<ClipId> stateClips;
+    std::vector<std::string> parameters;
+    std::vector<Transition> transitions;
+
+    // The first state added is the initial state
+    uint8_t AddState(const std::string& name, ClipId clip) {
+        assert(stateNames.size() < AnyState);
+        stateNames.push_back(name);
+        stateClips.push_back(clip);
+        return static_cast<uint8_t>(stateNames.size() - 1);
+    }
+
+    // NoParameter once all MaxParameters are in use
+    uint8_t AddParameter(const std::string& name) {
+        if (parameters.size() >= MaxParameters) return NoParameter;
+        parameters.push_back(name);
+        return static_cast<uint8_t>(parameters.size() - 1);
+    }
+
+    // Returns false (and adds nothing) for a parameter condition on an
+    // invalid parameter, e.g. NoParameter from a failed lookup
+    bool AddTransition(uint8_t from, uint8_t to, Condition condition, uint8_t parameter = 0) {
+        if (condition != Condition::Finished && parameter >= MaxParameters) return false;
+        transitions.push_back(Transition{from, to, condition, parameter});
+        return true;
+    }
+
+    uint8_t FindState(const std::string& name) const {
+        auto it = std::find(stateNames.begin(), stateNames.end(), name);
+        return it == stateNames.end() ? AnyState : static_cast<uint8_t>(it - stateNames.begin());
+    }
+
+    uint8_t FindParameter(const std::string& name) const {
+        auto it = std::find(parameters.begin(), parameters.end(), name);
+        return it == parameters.end() ? NoParameter : static_cast<uint8_t>(it - parameters.begin());
+    }
+};
+
+// Per-entity animation playback: 12 bytes, everything else is shared.
+// A plain struct rather than a Component so it carries no vtable pointer.
+struct Animator {
+    static constexpr MachineId NoMachine = 0xff;
+    static constexpr uint16_t FinishedBit = 0x8000;
+
+    ClipId clip = 0;
+    uint16_t frame = 0;
+    float time = 0.0f; // Into the current frame
+    MachineId machine = NoMachine;
+    uint8_t state = 0;
+    uint16_t flags = 0; // Parameter bits, plus FinishedBit
+
+    void Play(ClipId newClip) {
+        clip = newClip;
+        frame = 0;
+        time = 0.0f;
+        flags &= ~FinishedBit;
+    }
+
+    // Starts the machine in its initial state
+    void SetMachine(MachineId id);
+
+    // Bit for a parameter index; 0 for indices past MaxParameters, which
+    // would otherwise alias FinishedBit or shift out of range
+    static constexpr uint16_t ParameterBit(uint8_t parameter) {
+        return parameter < AnimationStateMachine::MaxParameters ? static_cast<uint16_t>(1u << parameter) : 0;
+    }
+
+    // Out-of-range parameters (including NoParameter) are ignored
+    void SetFlag(uint8_t parameter, bool value) {
+        if (value) flags |= ParameterBit(parameter);
+        else flags &= static_cast<uint16_t>(~ParameterBit(parameter));
+    }
+
+    void Trigger(uint8_t parameter) { SetFlag(parameter, true); }
+
+    bool IsFinished() const { return (flags & FinishedBit) != 0; }
+};
+static_assert(sizeof(Animator) == 12, "Animator is meant to stay this small");
+
+// Registry of clips and state machines. Per-clip timing is also kept in
+// flat arrays so the batched update reads a few floats per instance instead
+// of touching AnimationClip. Clip 0 is an empty placeholder.
+class AnimationLibrary {
+private:
+    struct Table {
+        std::deque<AnimationClip> clips;
+        std::vector<float> frameDuration;
+        std::vector<float> inverseDuration;
+        std::vector<uint16_t> frameCount;
+        std::vector<uint8_t> loops;
+        std::vector<AnimationStateMachine> machines;
+
+        Table() { AddClip(*this, AnimationClip{"", {}, {Rectangle{}}, {}, 0.0f, true}); }
+    };
+
+    static Table& Get() {
+        static Table table;
+        return table;
+    }
+
+    static ClipId AddClip(Table& table, AnimationClip clip) {
+        assert(table.clips.size() < UINT16_MAX);
+        if (clip.frames.empty() && clip.uvs.empty()) {
+            clip.frames.push_back(Rectangle{0, 0, static_cast<float>(clip.texture.width),
+                                            static_cast<float>(clip.texture.height)});
+        }
+        size_t frames = std::max(clip.uvs.size(), clip.frames.size());
+        table.frameDuration.push_back(clip.frameDuration);
+        table.inverseDuration.push_back(clip.frameDuration > 0.0f ? 1.0f / clip.frameDuration : 0.0f);
+        table.frameCount.push_back(static_cast<uint16_t>(std::max<size_t>(frames, 1)));
+        table.loops.push_back(clip.loop ? 1 : 0);
+        table.clips.push_back(std::move(clip));
+        return static_cast<ClipId>(table.clips.size() - 1);
+    }
+
+public:
+    static ClipId AddClip(AnimationClip clip) { return AddClip(Get(), std::move(clip)); }
+
+    // A horizontal strip of frameCount frames starting at the top-left
+    static ClipId AddClip(const std::string& name, Texture2D texture, float frameWidth, float frameHeight,
+                          int frameCount, float frameDuration, bool loop = true) {
+        AnimationClip clip{name, texture, {}, {}, frameDuration, loop};
+        for (int i = 0; i < frameCount; i++) {
+            clip.frames.push_back(Rectangle{frameWidth * i, 0, frameWidth, frameHeight});
+        }
+        return AddClip(std::move(clip));
+    }
+
+    // Every frame of an atlas sprite, in grid order
+    static ClipId AddClip(const std::string& name, const AtlasSprite& sprite, float frameDuration, bool loop = true) {
+        AnimationClip clip{name, sprite.texture, {}, sprite.frames, frameDuration, loop};
+        return AddClip(std::move(clip));
+    }
+
+    static ClipId FindClip(const std::string& name) {
+        const Table& table = Get();
+        for (size_t i = 1; i < table.clips.size(); i++) {
+            if (table.clips[i].name == name) return static_cast<ClipId>(i);
+        }
+        return 0;
+    }
+
+    static const AnimationClip& Clip(ClipId id) { return Get().clips[id]; }
+
+    static MachineId AddMachine(AnimationStateMachine machine) {
+        Table& table = Get();
+        assert(table.machines.size() < Animator::NoMachine && !machine.stateClips.empty());
+        table.machines.push_back(std::move(machine));
+        return static_cast<MachineId>(table.machines.size() - 1);
+    }
+
+    static const AnimationStateMachine& Machine(MachineId id) { return Get().machines[id]; }
+
+    // Advances one instance by dt, carrying the remainder into the next
+    // frame, then applies at most one state machine transition.
+    static void Advance(Animator& animator, float dt) {
+        const Table& table = Get();
+        const ClipId clip = animator.clip;
+        if (!(animator.flags & Animator::FinishedBit)) {
+            float time = animator.time + dt;
+            uint32_t advanced = static_cast<uint32_t>(time * table.inverseDuration[clip]);
+            if (advanced > 0) {
+                time -= advanced * table.frameDuration[clip];
+                uint32_t frame = animator.frame + advanced;
+                uint32_t count = table.frameCount[clip];
+                if (frame >= count) {
+                    if (table.loops[clip]) {
+                        frame %= count;
+                    } else {
+                        frame = count - 1;
+                        time = 0.0f;
+                        animator.flags |= Animator::FinishedBit;
+                    }
+                }
+                animator.frame = static_cast<uint16_t>(frame);
+            }
+            animator.time = time;
+        }
+
+        if (animator.machine == Animator::NoMachine) return;
+        const AnimationStateMachine& machine = table.machines[animator.machine];
+        for (const auto& transition : machine.transitions) {
+            if (transition.from != animator.state &&
+                (transition.from != AnimationStateMachine::AnyState || transition.to == animator.state)) {
+                continue;
+            }
+            const uint16_t bit = Animator::ParameterBit(transition.parameter);
+            bool take = false;
+            switch (transition.condition) {
+                case AnimationStateMachine::Condition::Trigger:
+                case AnimationStateMachine::Condition::FlagSet: take = (animator.flags & bit) != 0; break;
+                case AnimationStateMachine::Condition::FlagClear: take = (animator.flags & bit) == 0; break;
+                case AnimationStateMachine::Condition::Finished: take = animator.IsFinished(); break;
+            }
+            if (!take) continue;
+            if (transition.condition == AnimationStateMachine::Condition::Trigger) animator.flags &= ~bit;
+            animator.state = transition.to;
+            animator.Play(machine.stateClips[transition.to]);
+            return;
+        }
+    }
+};
+
+inline void Animator::SetMachine(MachineId id) {
+    const AnimationStateMachine& definition = AnimationLibrary::Machine(id);
+    machine = id;
+    state = 0;
+    Play(definition.stateClips[0]);
+}
+
+// Particle integration kernels. All variants are branchless: a particle
+// whose lifetime runs out this step keeps its position and velocity, and is
+// compacted away by the caller afterwards.
+namespace ParticleKernels {
+    enum class Kind { Scalar, SSE2, AVX2 };
+
+    struct Columns {
+        float* posX;
+        float* posY;
+        float* velX;
+        float* velY;
+        float* lifetime;
+        size_t count;
+    };
+
+    inline void UpdateScalar(const Columns& c, size_t begin, float dt, float gravity) {
+        for (size_t i = begin; i < c.count; i++) {
+            c.lifetime[i] -= dt;
+            float step = c.lifetime[i] > 0 ? dt : 0.0f;
+            c.posX[i] += c.velX[i] * step;
+            c.posY[i] += c.velY[i] * step;
+            c.velY[i] += gravity * step;
+        }
+    }
+
+#ifdef GAME_ENGINE_SIMD_X86
+    __attribute__((target("sse2")))
+    inline void UpdateSSE2(const Columns& c, float dt, float gravity) {
+        const __m128 vdt = _mm_set1_ps(dt);
+        const __m128 vgravity = _mm_set1_ps(gravity);
+        const __m128 zero = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= c.count; i += 4) {
+            __m128 life = _mm_sub_ps(_mm_loadu_ps(c.lifetime + i), vdt);
+            __m128 step = _mm_and_ps(_mm_cmpgt_ps(life, zero), vdt);
+            __m128 vx = _mm_loadu_ps(c.velX + i);
+            __m128 vy = _mm_loadu_ps(c.velY + i);
+            _mm_storeu_ps(c.lifetime + i, life);
+            _mm_storeu_ps(c.posX + i, _mm_add_ps(_mm_loadu_ps(c.posX + i), _mm_mul_ps(vx, step)));
+            _mm_storeu_ps(c.posY + i, _mm_add_ps(_mm_loadu_ps(c.posY + i), _mm_mul_ps(vy, step)));
+            _mm_storeu_ps(c.velY + i, _mm_add_ps(vy, _mm_mul_ps(vgravity, step)));
+        }
+        UpdateScalar(c, i, dt, gravity);
+    }
+
+    __attribute__((target("avx2")))
+    inline void UpdateAVX2(const Columns& c, float dt, float gravity) {
+        const __m256 vdt = _mm256_set1_ps(dt);
+        const __m256 vgravity = _mm256_set1_ps(gravity);
+        const __m256 zero = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= c.count; i += 8) {
+            __m256 life = _mm256_sub_ps(_mm256_loadu_ps(c.lifetime + i), vdt);
+            __m256 step = _mm256_and_ps(_mm256_cmp_ps(life, zero, _CMP_GT_OQ), vdt);
+            __m256 vx = _mm256_loadu_ps(c.velX + i);
+            __m256 vy = _mm256_loadu_ps(c.velY + i);
+            _mm256_storeu_ps(c.lifetime + i, life);
+            _mm256_storeu_ps(c.posX + i, _mm256_add_ps(_mm256_loadu_ps(c.posX + i), _mm256_mul_ps(vx, step)));
+            _mm256_storeu_ps(c.posY + i, _mm256_add_ps(_mm256_loadu_ps(c.posY + i), _mm256_mul_ps(vy, step)));
+            _mm256_storeu_ps(c.velY + i, _mm256_add_ps(vy, _mm256_mul_ps(vgravity, step)));
+        }
+        UpdateScalar(c, i, dt, gravity);
+    }
+#endif
+
+    // Best kernel supported by the running CPU, detected once via CPUID.
+    inline Kind Detect() {
+#ifdef GAME_ENGINE_SIMD_X86
+        static const Kind best = __builtin_cpu_supports("avx2") ? Kind::AVX2
+                               : __builtin_cpu_supports("sse2") ? Kind::SSE2
+                               : Kind::Scalar;
+        return best;
+#else
+        return Kind::Scalar;
+#endif
+    }
+
+    inline bool IsSupported(Kind kind) {
+        return kind == Kind::Scalar || static_cast<int>(kind) <= static_cast<int>(Detect());
+    }
+
+    inline void Update(Kind kind, const Columns& c, float dt, float gravity) {
+        switch (kind) {
+#ifdef GAME_ENGINE_SIMD_X86
+            case Kind::AVX2: UpdateAVX2(c, dt, gravity); return;
+            case Kind::SSE2: UpdateSSE2(c, dt, gravity); return;
+#endif
+            default: UpdateScalar(c, 0, dt, gravity); return;
+        }
+    }
+}
+
+// Scene-wide particle storage. Particles of every emitter share one
+// fixed-capacity pool laid out as parallel arrays; dead particles are
+// swap-removed so [0, count) is always the live set.
+class ParticleSystem {
+public:
+    enum class DropPolicy {
+        DropNew,        // Reject emissions once the pool is full
+        RecycleExisting // Overwrite live particles round-robin
+    };
+
+    static constexpr float Gravity = 200.0f;
+
+private:
+    size_t capacity = 0;
+    size_t count = 0;
+    size_t recycleCursor = 0;
+    size_t dropped = 0;
+    DropPolicy dropPolicy;
+    ParticleKernels::Kind kernel = ParticleKernels::Detect();
+
+    std::vector<float> posX, posY;
+    std::vector<float> velX, velY;
+    std::vector<float> lifetime, invMaxLifetime;
+    std::vector<float> size;
+    std::vector<Color> color, endColor;
+
+    void Kill(size_t i) {
+        size_t last = --count;
+        if (i == last) return;
+        posX[i] = posX[last];
+        posY[i] = posY[last];
+        velX[i] = velX[last];
+        velY[i] = velY[last];
+        lifetime[i] = lifetime[last];
+        invMaxLifetime[i] = invMaxLifetime[last];
+        size[i] = size[last];
+        color[i] = color[last];
+        endColor[i] = endColor[last];
+    }
+
+    // Fades from color to endColor over the particle's life, alpha to zero
+    Color Tint(size_t i) const {
+        float t = lifetime[i] * invMaxLifetime[i];
+        const Color& a = color[i];
+        const Color& b = endColor[i];
+        return Color{
+            static_cast<unsigned char>(b.r + (a.r - b.r) * t),
+            static_cast<unsigned char>(b.g + (a.g - b.g) * t),
+            static_cast<unsigned char>(b.b + (a.b - b.b) * t),
+            static_cast<unsigned char>(255 * t)
+        };
+    }
+
+public:
+    explicit ParticleSystem(size_t maxParticles = 65536, DropPolicy policy = DropPolicy::DropNew)
+        : dropPolicy(policy) {
+        SetCapacity(maxParticles);
+    }
+
+    // Resizes the pool; live particles beyond the new cap are discarded.
+    void SetCapacity(size_t maxParticles) {
+        capacity = maxParticles;
+        count = std::min(count, capacity);
+        for (auto* column : {&posX, &posY, &velX, &velY, &lifetime, &invMaxLifetime, &size}) {
+            column->resize(capacity);
+        }
+        color.resize(capacity);
+        endColor.resize(capacity);
+    }
+
+    void SetDropPolicy(DropPolicy policy) { dropPolicy = policy; }
+
+    // Returns false if the particle was dropped because the pool is full.
+    bool Emit(Vector2 position, Vector2 velocity, float life, Color tint, float radius) {
+        size_t i;
+        if (count < capacity) {
+            i = count++;
+        } else if (dropPolicy == DropPolicy::RecycleExisting && capacity > 0) {
+            i = recycleCursor++ % capacity;
+        } else {
+            dropped++;
+            return false;
+        }
+        posX[i] = position.x;
+        posY[i] = position.y;
+        velX[i] = velocity.x;
+        velY[i] = velocity.y;
+        lifetime[i] = life;
+        invMaxLifetime[i] = life > 0 ? 1.0f / life : 0.0f;
+        size[i] = radius;
+        color[i] = tint;
+        endColor[i] = tint;
+        return true;
+    }
+
+    // A contiguous run of freshly allocated particles for EmitBatch to fill
+    struct Span {
+        float* posX;
+        float* posY;
+        float* velX;
+        float* velY;
+        float* lifetime;
+        float* size;
+        Color* color;
+        Color* endColor;
+        size_t count;
+    };
+
+    // Allocates up to n particles at once and hands them to fill(const
+    // Span&) in at most a couple of contiguous runs (one when the pool has
+    // room). fill must set every column in the span. Returns how many
+    // particles were emitted; the rest count as dropped.
+    template<typename Fn>
+    size_t EmitBatch(size_t n, Fn&& fill) {
+        size_t emitted = 0;
+        auto run = [&](size_t start, size_t k) {
+            fill(Span{posX.data() + start, posY.data() + start, velX.data() + start,
+                      velY.data() + start, lifetime.data() + start, size.data() + start,
+                      color.data() + start, endColor.data() + start, k});
+            for (size_t i = start; i < start + k; i++) {
+                invMaxLifetime[i] = lifetime[i] > 0 ? 1.0f / lifetime[i] : 0.0f;
+            }
+            emitted += k;
+        };
+
+        size_t fresh = std::min(n, capacity - count);
+        if (fresh > 0) {
+            run(count, fresh);
+            count += fresh;
+        }
+        size_t remaining = n - fresh;
+        if (dropPolicy == DropPolicy::RecycleExisting && capacity > 0) {
+            while (remaining > 0) {
+                size_t start = recycleCursor % capacity;
+                size_t k = std::min(remaining, capacity - start);
+                run(start, k);
+                recycleCursor += k;
+                remaining -= k;
+            }
+        }
+        dropped += remaining;
+        return emitted;
+    }
+
+    // Forces a specific integration kernel; ignored if the CPU lacks it.
+    void SetKernel(ParticleKernels::Kind kind) {
+        if (ParticleKernels::IsSupported(kind)) kernel = kind;
+    }
+
+    ParticleKernels::Kind GetKernel() const { return kernel; }
+
+    // Integration runs in chunks on the job system; compaction is serial.
+    void Update(float dt, JobSystem& jobs) {
+        jobs.ParallelFor(count, 16384, [&](size_t begin, size_t end) {
+            ParticleKernels::Update(kernel, ParticleKernels::Columns{
+                posX.data() + begin, posY.data() + begin, velX.data() + begin,
+                velY.data() + begin, lifetime.data() + begin, end - begin
+            }, dt, Gravity);
+        });
+        Compact();
+    }
+
+    void Update(float dt) {
+        ParticleKernels::Update(kernel, ParticleKernels::Columns{
+            posX.data(), posY.data(), velX.data(), velY.data(), lifetime.data(), count
+        }, dt, Gravity);
+        Compact();
+    }
+
+    // Swaps the last live particle into each dead slot
+    void Compact() {
+        for (size_t i = 0; i < count;) {
+            if (lifetime[i] <= 0) {
+                Kill(i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void Draw(RenderBatch& batch, int layer = 0) const {
+        for (size_t i = 0; i < count; i++) {
+            batch.DrawCircle(Vector2{posX[i], posY[i]}, size[i], Tint(i), layer);
+        }
+    }
+
+    // Draws only particles whose circle touches `visible`
+    void Draw(RenderBatch& batch, const Rectangle& visible, int layer = 0) const {
+        const float right = visible.x + visible.width;
+        const float bottom = visible.y + visible.height;
+        for (size_t i = 0; i < count; i++) {
+            float r = size[i];
+            if (posX[i] + r < visible.x || posX[i] - r > right ||
+                posY[i] + r < visible.y || posY[i] - r > bottom) {
+                continue;
+            }
+            batch.DrawCircle(Vector2{posX[i], posY[i]}, r, Tint(i), layer);
+        }
+    }
+
+    void Clear() { count = 0; }
+
+    size_t Count() const { return count; }
+
+    struct Particle {
+        Vector2 position;
+        Vector2 velocity;
+        float lifetime; // Seconds left
+        float size;
+        Color color;
+        Color endColor;
+    };
+
+    // Live particle i, 0 <= i < Count(); indices shift as particles die
+    Particle GetParticle(size_t i) const {
+        return Particle{Vector2{posX[i], posY[i]}, Vector2{velX[i], velY[i]}, lifetime[i], size[i],
+                        color[i], endColor[i]};
+    }
+    size_t Capacity() const { return capacity; }
+    size_t DroppedCount() const { return dropped; }
+};
+
+// Shared, immutable emission settings. Register presets at load time and
+// point any number of emitters at one by id instead of giving each its own
+// copy. Values are drawn uniformly from each [min, max] range; color fades
+// from startColor to endColor over a particle's life.
+using PresetId = uint16_t;
+
+struct ParticlePreset {
+    float lifetimeMin = 1.0f, lifetimeMax = 1.0f;
+    float speedMin = 50.0f, speedMax = 100.0f;
+    float sizeMin = 2.0f, sizeMax = 5.0f;
+    Color startColor = WHITE;
+    Color endColor = WHITE;
+};
+
+class ParticlePresets {
+private:
+    // Id 0 is reserved for "use the emitter's own settings"
+    static std::deque<ParticlePreset>& Table() {
+        static std::deque<ParticlePreset> table(1);
+        return table;
+    }
+
+public:
+    static PresetId Add(const ParticlePreset& preset) {
+        auto& table = Table();
+        assert(table.size() < UINT16_MAX);
+        table.push_back(preset);
+        return static_cast<PresetId>(table.size() - 1);
+    }
+
+    static const ParticlePreset& Get(PresetId id) {
+        auto& table = Table();
+        assert(id < table.size());
+        return table[id];
+    }
+};
+
+// Particle component. Holds only emission settings; the particles
+// themselves live in the scene's ParticleSystem. Time accumulates across
+// ticks, so emitRate is particles per second regardless of tick rate, and
+// every particle due in a tick is emitted as one batch.
+struct ParticleEmitter : public Component {
+    Vector2 offset{0, 0};
+    float emitRate = 10;
+    float emitTimer = 0;
+    float particleLifetime = 1.0f;
+    Color particleColor = WHITE;
+    float particleSpeed = 100.0f;
+    bool emitting = true;
+    PresetId preset = 0;        // 0: use the particle* fields above
+    uint32_t pendingBurst = 0;
+
+    // Queues count particles for the next update, even when not emitting
+    void Burst(uint32_t count) { pendingBurst += count; }
+
+    // rng defaults to the calling thread's stream; the scene passes its own
+    // so emission doesn't depend on which worker runs the particle stage
+    void Update(const Vector2& emitterPos, ParticleSystem& system, Rng& rng = Random::Local()) {
+        size_t count = pendingBurst;
+        pendingBurst = 0;
+        if (emitting && emitRate > 0) {
+            emitTimer += DeltaTime::Get();
+            size_t due = static_cast<size_t>(emitTimer * emitRate);
+            emitTimer = std::max(0.0f, emitTimer - due / emitRate);
+            count += due;
+        }
+        if (count > 0) Emit(emitterPos, system, count, rng);
+    }
+
+    ParticlePreset Settings() const {
+        if (preset != 0) return ParticlePresets::Get(preset);
+        ParticlePreset settings;
+        settings.lifetimeMin = settings.lifetimeMax = particleLifetime;
+        settings.speedMin = particleSpeed * 0.5f;
+        settings.speedMax = particleSpeed;
+        settings.startColor = settings.endColor = particleColor;
+        return settings;
+    }
+
+    void Emit(const Vector2& emitterPos, ParticleSystem& system, size_t count, Rng& rng = Random::Local()) {
+        const ParticlePreset settings = Settings();
+        const Vector2 origin{emitterPos.x + offset.x, emitterPos.y + offset.y};
+        system.EmitBatch(count, [&](const ParticleSystem::Span& span) {
+            std::fill_n(span.posX, span.count, origin.x);
+            std::fill_n(span.posY, span.count, origin.y);
+            std::fill_n(span.color, span.count, settings.startColor);
+            std::fill_n(span.endColor, span.count, settings.endColor);
+            rng.FillRange(span.lifetime, span.count, settings.lifetimeMin, settings.lifetimeMax);
+            rng.FillRange(span.size, span.count, settings.sizeMin, settings.sizeMax);
+            // Speeds go into velX first, then get scaled onto a direction
+            rng.FillRange(span.velX, span.count, settings.speedMin, settings.speedMax);
+            for (size_t i = 0; i < span.count; i++) {
+                Vector2 direction = rng.Direction();
+                span.velY[i] = direction.y * span.velX[i];
+                span.velX[i] *= direction.x;
+            }
+        });
+    }
+
+    void EmitParticle(const Vector2& emitterPos, ParticleSystem& system) {
+        Emit(emitterPos, system, 1);
+    }
+};
+
+// Uniform-grid broadphase. Cells are hashed into a fixed-size table and
+// rebuilt from scratch with a counting sort, so a rebuild is O(n) with no
+// per-cell allocations. Each overlap is reported once: only from the cell
+// containing the top-left corner of the intersection.
+class SpatialGrid {
+public:
+    struct Item {
+        Rectangle bounds;
+        uint32_t layers;
+    };
+
+private:
+    float cellSize = 64.0f;
+    float invCellSize = 1.0f / 64.0f;
+    uint32_t tableMask = 0;
+
+    std::vector<Item> items;
+    std::vector<uint32_t> cellStart;  // tableSize + 1 prefix offsets
+    std::vector<uint32_t> cellItems;
+    std::vector<uint32_t> lastItem;   // dedupe an item hashing to one bucket twice
+
+    int CellCoord(float v) const {
+        return static_cast<int>(std::floor(v * invCellSize));
+    }
+
+    uint32_t Hash(int cx, int cy) const {
+        return (static_cast<uint32_t>(cx) * 73856093u ^ static_cast<uint32_t>(cy) * 19349663u) & tableMask;
+    }
+
+    static bool Overlaps(const Rectangle& a, const Rectangle& b) {
+        return a.x < b.x + b.width && b.x < a.x + a.width &&
+               a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+
+    template<typename Fn>
+    void ForEachCell(const Rectangle& r, Fn&& fn) const {
+        int x0 = CellCoord(r.x), x1 = CellCoord(r.x + r.width);
+        int y0 = CellCoord(r.y), y1 = CellCoord(r.y + r.height);
+        for (int cy = y0; cy <= y1; cy++) {
+            for (int cx = x0; cx <= x1; cx++) {
+                fn(cx, cy);
+            }
+        }
+    }
+
+public:
+    void SetCellSize(float size) {
+        cellSize = size;
+        invCellSize = 1.0f / size;
+    }
+
+    float GetCellSize() const { return cellSize; }
+
+    void Clear() { items.clear(); }
+
+    // Returns the item index to use with Build/Query callbacks.
+    uint32_t Add(const Rectangle& bounds, uint32_t layers) {
+        items.push_back(Item{bounds, layers});
+        return static_cast<uint32_t>(items.size() - 1);
+    }
+
+    void Build() {
+        uint32_t tableSize = 1024;
+        while (tableSize < items.size() * 2) tableSize <<= 1;
+        tableMask = tableSize - 1;
+
+        cellStart.assign(tableSize + 1, 0);
+        lastItem.assign(tableSize, UINT32_MAX);
+        for (uint32_t i = 0; i < items.size(); i++) {
+            ForEachCell(items[i].bounds, [&](int cx, int cy) {
+                uint32_t h = Hash(cx, cy);
+                if (lastItem[h] == i) return;
+                lastItem[h] = i;
+                cellStart[h + 1]++;
+            });
+        }
+        for (uint32_t h = 0; h < tableSize; h++) {
+            cellStart[h + 1] += cellStart[h];
+        }
+
+        cellItems.resize(cellStart[tableSize]);
+        std::vector<uint32_t>& cursor = lastItem;
+        std::copy(cellStart.begin(), cellStart.end() - 1, cursor.begin());
+        for (uint32_t i = 0; i < items.size(); i++) {
+            ForEachCell(items[i].bounds, [&](int cx, int cy) {
+                uint32_t h = Hash(cx, cy);
+                if (cursor[h] > cellStart[h] && cellItems[cursor[h] - 1] == i) return;
+                cellItems[cursor[h]++] = i;
+            });
+        }
+    }
+
+    // fn(itemIndex) for every item overlapping area whose layers intersect mask
+    template<typename Fn>
+    void QueryAABB(const Rectangle& area, uint32_t mask, Fn&& fn) const {
+        if (items.empty()) return;
+        ForEachCell(area, [&](int cx, int cy) {
+            uint32_t h = Hash(cx, cy);
+            for (uint32_t k = cellStart[h]; k < cellStart[h + 1]; k++) {
+                uint32_t i = cellItems[k];
+                const Item& item = items[i];
+                if (!(item.layers & mask) || !Overlaps(area, item.bounds)) continue;
+                if (CellCoord(std::max(area.x, item.bounds.x)) != cx ||
+                    CellCoord(std::max(area.y, item.bounds.y)) != cy) continue;
+                fn(i);
+            }
+        });
+    }
+
+    template<typename Fn>
+    void QueryRadius(Vector2 center, float radius, uint32_t mask, Fn&& fn) const {
+        Rectangle area{center.x - radius, center.y - radius, radius * 2, radius * 2};
+        QueryAABB(area, mask, [&](uint32_t i) {
+            const Rectangle& b = items[i].bounds;
+            float nx = std::clamp(center.x, b.x, b.x + b.width) - center.x;
+            float ny = std::clamp(center.y, b.y, b.y + b.height) - center.y;
+            if (nx * nx + ny * ny <= radius * radius) fn(i);
+        });
+    }
+
+    // fn(a, b) once per overlapping pair where a is in maskA and b in maskB
+    template<typename Fn>
+    void ForEachOverlappingPair(uint32_t maskA, uint32_t maskB, Fn&& fn) const {
+        for (uint32_t h = 0; h + 1 < cellStart.size(); h++) {
+            uint32_t begin = cellStart[h], end = cellStart[h + 1];
+            for (uint32_t k = begin; k < end; k++) {
+                uint32_t a = cellItems[k];
+                const Item& itemA = items[a];
+                for (uint32_t m = k + 1; m < end; m++) {
+                    uint32_t b = cellItems[m];
+                    const Item& itemB = items[b];
+                    bool ab = (itemA.layers & maskA) && (itemB.layers & maskB);
+                    bool ba = (itemB.layers & maskA) && (itemA.layers & maskB);
+                    if (!(ab || ba) || !Overlaps(itemA.bounds, itemB.bounds)) continue;
+                    int cx = CellCoord(std::max(itemA.bounds.x, itemB.bounds.x));
+                    int cy = CellCoord(std::max(itemA.bounds.y, itemB.bounds.y));
+                    if (Hash(cx, cy) != h) continue;
+                    if (ab) fn(a, b);
+                    else fn(b, a);
+                }
+            }
+        }
+    }
+
+    size_t Size() const { return items.size(); }
+    const Item& GetItem(uint32_t i) const { return items[i]; }
+};
+
+// Ray/box helper shared by the broadphases: slab test of the segment
+// origin + t * delta, t in [0, maxT], against box. Returns the entry t.
+inline bool RaycastRect(Vector2 origin, Vector2 delta, const Rectangle& box, float maxT, float& tHit) {
+    float tMin = 0.0f, tMax = maxT;
+    const float o[2] = {origin.x, origin.y};
+    const float d[2] = {delta.x, delta.y};
+    const float lo[2] = {box.x, box.y};
+    const float hi[2] = {box.x + box.width, box.y + box.height};
+    for (int axis = 0; axis < 2; axis++) {
+        if (std::fabs(d[axis]) < 1e-12f) {
+            if (o[axis] < lo[axis] || o[axis] > hi[axis]) return false;
+            continue;
+        }
+        float inv = 1.0f / d[axis];
+        float t1 = (lo[axis] - o[axis]) * inv;
+        float t2 = (hi[axis] - o[axis]) * inv;
+        if (t1 > t2) std::swap(t1, t2);
+        tMin = std::max(tMin, t1);
+        tMax = std::min(tMax, t2);
+        if (tMin > tMax) return false;
+    }
+    tHit = tMin;
+    return true;
+}
+
+// Dynamic bounding-volume tree. Leaves store fattened AABBs so small
+// movements don't touch the tree; insertion picks the sibling with the
+// lowest perimeter (SAH) cost and the tree is kept height-balanced with
+// AVL-style rotations. Suited to huge static geometry mixed with sparse
+// fast movers, where a uniform grid wastes memory or cells.
+class DynamicAABBTree {
+public:
+    static constexpr int32_t Null = -1;
+
+    struct Node {
+        Rectangle aabb;     // Fat AABB for leaves
+        Rectangle tight;    // Exact bounds (leaves only)
+        uint32_t layers = 0;
+        uint32_t userData = 0;
+        int32_t parent = Null; // Doubles as free-list link
+        int32_t child1 = Null;
+        int32_t child2 = Null;
+        int32_t height = -1;   // Leaf = 0, free = -1
+
+        bool IsLeaf() const { return child1 == Null; }
+    };
+
+private:
+    std::vector<Node> nodes;
+    int32_t root = Null;
+    int32_t freeList = Null;
+    float margin = 8.0f;
+    float displacementMultiplier = 2.0f;
+
+    // Traversal stack on the C++ stack; spills to the heap only for
+    // degenerate trees deeper than the inline buffer
+    struct NodeStack {
+        int32_t inlineBuffer[128];
+        std::vector<int32_t> overflow;
+        size_t size = 0;
+
+        void Push(int32_t id) {
+            if (size < 128) inlineBuffer[size] = id;
+            else overflow.push_back(id);
+            size++;
+        }
+        int32_t Pop() {
+            size--;
+            if (size < 128) return inlineBuffer[size];
+            int32_t id = overflow.back();
+            overflow.pop_back();
+            return id;
+        }
+        bool Empty() const { return size == 0; }
+    };
+
+    static Rectangle Union(const Rectangle& a, const Rectangle& b) {
+        float x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+        float x1 = std::max(a.x + a.width, b.x + b.width);
+        float y1 = std::max(a.y + a.height, b.y + b.height);
+        return Rectangle{x0, y0, x1 - x0, y1 - y0};
+    }
+
+    static float Perimeter(const Rectangle& r) { return 2.0f * (r.width + r.height); }
+
+    static bool Contains(const Rectangle& outer, const Rectangle& inner) {
+        return outer.x <= inner.x && outer.y <= inner.y &&
+               inner.x + inner.width <= outer.x + outer.width &&
+               inner.y + inner.height <= outer.y + outer.height;
+    }
+
+    static bool Overlaps(const Rectangle& a, const Rectangle& b) {
+        return a.x < b.x + b.width && b.x < a.x + a.width &&
+               a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+
+    int32_t AllocateNode() {
+        if (freeList == Null) {
+            nodes.emplace_back();
+            return static_cast<int32_t>(nodes.size() - 1);
+        }
+        int32_t id = freeList;
+        freeList = nodes[id].parent;
+        nodes[id] = Node{};
+        return id;
+    }
+
+    void FreeNode(int32_t id) {
+        nodes[id].parent = freeList;
+        nodes[id].height = -1;
+        freeList = id;
+    }
+
+    Rectangle Fatten(const Rectangle& r, Vector2 displacement) const {
+        Rectangle fat{r.x - margin, r.y - margin, r.width + 2 * margin, r.height + 2 * margin};
+        float dx = displacementMultiplier * displacement.x;
+        float dy = displacementMultiplier * displacement.y;
+        if (dx < 0) fat.x += dx;
+        fat.width += std::fabs(dx);
+        if (dy < 0) fat.y += dy;
+        fat.height += std::fabs(dy);
+        return fat;
+    }
+
+    void InsertLeaf(int32_t leaf) {
+        if (root == Null) {
+            root = leaf;
+            nodes[root].parent = Null;
+            return;
+        }
+
+        // Descend towards the sibling that minimises the added perimeter
+        Rectangle leafBox = nodes[leaf].aabb;
+        int32_t index = root;
+        while (!nodes[index].IsLeaf()) {
+            int32_t c1 = nodes[index].child1, c2 = nodes[index].child2;
+            float area = Perimeter(nodes[index].aabb);
+            float combined = Perimeter(Union(nodes[index].aabb, leafBox));
+            float cost = 2.0f * combined;
+            float inheritance = 2.0f * (combined - area);
+
+            auto descendCost = [&](int32_t child) {
+                float grown = Perimeter(Union(leafBox, nodes[child].aabb));
+                if (nodes[child].IsLeaf()) return grown + inheritance;
+                return grown - Perimeter(nodes[child].aabb) + inheritance;
+            };
+            float cost1 = descendCost(c1);
+            float cost2 = descendCost(c2);
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? c1 : c2;
+        }
+
+        int32_t sibling = index;
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = AllocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].aabb = Union(leafBox, nodes[sibling].aabb);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent == Null) {
+            root = newParent;
+        } else if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+
+        RefitFrom(nodes[leaf].parent);
+    }
+
+    void RemoveLeaf(int32_t leaf) {
+        if (leaf == root) {
+            root = Null;
+            return;
+        }
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+        if (grandParent == Null) {
+            root = sibling;
+            nodes[sibling].parent = Null;
+            FreeNode(parent);
+            return;
+        }
+        if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+        else nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        FreeNode(parent);
+        RefitFrom(grandParent);
+    }
+
+    void RefitFrom(int32_t index) {
+        while (index != Null) {
+            index = Balance(index);
+            int32_t c1 = nodes[index].child1, c2 = nodes[index].child2;
+            nodes[index].height = 1 + std::max(nodes[c1].height, nodes[c2].height);
+            nodes[index].aabb = Union(nodes[c1].aabb, nodes[c2].aabb);
+            index = nodes[index].parent;
+        }
+    }
+
+    // Rotates the taller grandchild up when a node's children differ in
+    // height by more than one. Returns the subtree's new root.
+    int32_t Balance(int32_t a) {
+        Node& A = nodes[a];
+        if (A.IsLeaf() || A.height < 2) return a;
+
+        int32_t b = A.child1, c = A.child2;
+        int32_t balance = nodes[c].height - nodes[b].height;
+        if (balance > 1) return Rotate(a, c, b);
+        if (balance < -1) return Rotate(a, b, c);
+        return a;
+    }
+
+    // Promotes `up` (a child of a) above a; `other` is a's remaining child.
+    int32_t Rotate(int32_t a, int32_t up, int32_t other) {
+        int32_t f = nodes[up].child1, g = nodes[up].child2;
+
+        nodes[up].child1 = a;
+        nodes[up].parent = nodes[a].parent;
+        nodes[a].parent = up;
+        if (nodes[up].parent == Null) {
+            root = up;
+        } else if (nodes[nodes[up].parent].child1 == a) {
+            nodes[nodes[up].parent].child1 = up;
+        } else {
+            nodes[nodes[up].parent].child2 = up;
+        }
+
+        // Keep the taller grandchild under `up`, hand the other to `a`
+        int32_t keep = nodes[f].height > nodes[g].height ? f : g;
+        int32_t give = keep == f ? g : f;
+        nodes[up].child2 = keep;
+        if (nodes[a].child1 == up) nodes[a].child1 = give;
+        else nodes[a].child2 = give;
+        nodes[give].parent = a;
+
+        nodes[a].aabb = Union(nodes[other].aabb, nodes[give].aabb);
+        nodes[a].height = 1 + std::max(nodes[other].height, nodes[give].height);
+        nodes[up].aabb = Union(nodes[a].aabb, nodes[keep].aabb);
+        nodes[up].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+        return up;
+    }
+
+public:
+    void SetMargin(float fatMargin) { margin = fatMargin; }
+
+    int32_t CreateProxy(const Rectangle& bounds, uint32_t layers, uint32_t userData) {
+        int32_t id = AllocateNode();
+        nodes[id].aabb = Fatten(bounds, Vector2{0, 0});
+        nodes[id].tight = bounds;
+        nodes[id].layers = layers;
+        nodes[id].userData = userData;
+        nodes[id].height = 0;
+        InsertLeaf(id);
+        return id;
+    }
+
+    void DestroyProxy(int32_t id) {
+        RemoveLeaf(id);
+        FreeNode(id);
+    }
+
+    // Returns true if the proxy had to be reinserted.
+    bool MoveProxy(int32_t id, const Rectangle& bounds, Vector2 displacement, uint32_t layers) {
+        nodes[id].tight = bounds;
+        nodes[id].layers = layers;
+        if (Contains(nodes[id].aabb, bounds)) return false;
+        RemoveLeaf(id);
+        nodes[id].aabb = Fatten(bounds, displacement);
+        InsertLeaf(id);
+        return true;
+    }
+
+    uint32_t GetUserData(int32_t id) const { return nodes[id].userData; }
+    const Rectangle& GetBounds(int32_t id) const { return nodes[id].tight; }
+    int32_t GetHeight() const { return root == Null ? 0 : nodes[root].height; }
+
+    // fn(proxyId) for leaves whose exact bounds overlap area
+    template<typename Fn>
+    void QueryAABB(const Rectangle& area, uint32_t mask, Fn&& fn) const {
+        if (root == Null) return;
+        NodeStack stack;
+        stack.Push(root);
+        while (!stack.Empty()) {
+            int32_t id = stack.Pop();
+            const Node& node = nodes[id];
+            if (!Overlaps(node.aabb, area)) continue;
+            if (node.IsLeaf()) {
+                if ((node.layers & mask) && Overlaps(node.tight, area)) fn(id);
+            } else {
+                stack.Push(node.child1);
+                stack.Push(node.child2);
+            }
+        }
+    }
+
+    template<typename Fn>
+    void QueryRadius(Vector2 center, float radius, uint32_t mask, Fn&& fn) const {
+        Rectangle area{center.x - radius, center.y - radius, radius * 2, radius * 2};
+        QueryAABB(area, mask, [&](int32_t id) {
+            const Rectangle& b = nodes[id].tight;
+            float nx = std::clamp(center.x, b.x, b.x + b.width) - center.x;
+            float ny = std::clamp(center.y, b.y, b.y + b.height) - center.y;
+            if (nx * nx + ny * ny <= radius * radius) fn(id);
+        });
+    }
+
+    // fn(proxyA, proxyB) once per overlapping pair, a in maskA and b in maskB
+    template<typename Fn>
+    void ForEachOverlappingPair(uint32_t maskA, uint32_t maskB, Fn&& fn) const {
+        for (int32_t id = 0; id < static_cast<int32_t>(nodes.size()); id++) {
+            const Node& a = nodes[id];
+            if (a.height != 0 || !(a.layers & (maskA | maskB))) continue;
+            QueryAABB(a.tight, maskA | maskB, [&](int32_t other) {
+                if (other <= id) return;
+                const Node& b = nodes[other];
+                if ((a.layers & maskA) && (b.layers & maskB)) fn(id, other);
+                else if ((b.layers & maskA) && (a.layers & maskB)) fn(other, id);
+            });
+        }
+    }
+
+    // Casts the segment origin -> origin + delta. fn(proxyId, t) returns
+    // the new max t (return t to clip to the closest hit, maxT to keep going,
+    // 0 to stop).
+    template<typename Fn>
+    void Raycast(Vector2 origin, Vector2 delta, uint32_t mask, Fn&& fn) const {
+        Sweep(Rectangle{origin.x, origin.y, 0, 0}, delta, mask, std::forward<Fn>(fn));
+    }
+
+    // Moves box by delta and reports proxies it would touch with the time
+    // of impact in [0, 1]; same callback contract as Raycast.
+    template<typename Fn>
+    void Sweep(const Rectangle& box, Vector2 delta, uint32_t mask, Fn&& fn) const {
+        float hw = box.width * 0.5f, hh = box.height * 0.5f;
+        Vector2 center{box.x + hw, box.y + hh};
+        float maxT = 1.0f;
+        if (root == Null) return;
+        NodeStack stack;
+        stack.Push(root);
+        while (!stack.Empty()) {
+            int32_t id = stack.Pop();
+            const Node& node = nodes[id];
+            const Rectangle& b = node.IsLeaf() ? node.tight : node.aabb;
+            Rectangle expanded{b.x - hw, b.y - hh, b.width + box.width, b.height + box.height};
+            float t;
+            if (!RaycastRect(center, delta, expanded, maxT, t)) continue;
+            if (node.IsLeaf()) {
+                if (!(node.layers & mask)) continue;
+                maxT = fn(id, t);
+                if (maxT <= 0.0f) return;
+            } else {
+                stack.Push(node.child1);
+                stack.Push(node.child2);
+            }
+        }
+    }
+};
+
+class Entity {
+private:
+    struct PendingComponent {
+        ComponentId type;
+        std::shared_ptr<void> component;
+        void (*attach)(Registry&, EntityId, std::shared_ptr<void>&);
+    };
+
+    Registry* registry = nullptr;
+    EntityId id;
+    TagId tagId = Tags::None;
+    uint32_t tagSlot = 0;   // Position in the scene's per-tag index
+    uint32_t sceneSlot = 0; // Position in Scene::entities
+    // Positions in the scene's spatial lists, so destroyed entities can be
+    // dropped from them without waiting for the next index rebuild
+    uint32_t gridSlot = UINT32_MAX;
+    uint32_t unindexedSlot = UINT32_MAX;
+    bool destroyQueued = false;
+    // Components added before the entity joins a scene; moved into the
+    // scene's pools by Attach.
+    std::vector<PendingComponent> pending;
+
+    friend class Scene;
+
+    void Attach(Registry& owner, EntityId entityId) {
+        registry = &owner;
+        id = entityId;
+        for (auto& p : pending) {
+            p.attach(owner, id, p.component);
+        }
+        pending.clear();
+    }
+
+public:
+    Vector2 position{0, 0};
+    Vector2 size{32, 32};
+    Color color{WHITE};
+    bool active{true};
+    // Skipped by Update and component systems but still drawn and
+    // collidable; WorldStreamer puts entities outside the active area to sleep
+    bool sleeping{false};
+    float rotation{0.0f};
+    Vector2 velocity{0, 0};
+    Vector2 acceleration{0, 0};
+    std::string tag;
+    uint32_t collisionLayers{1};
+    // State at the start of the current tick, for render interpolation
+    Vector2 previousPosition{0, 0};
+    float previousRotation{0.0f};
+
+    virtual ~Entity() = default;
+
+    EntityId GetId() const { return id; }
+    TagId GetTagId() const { return tagId; }
+
+    void SavePreviousState() {
+        previousPosition = position;
+        previousRotation = rotation;
+    }
+
+    Vector2 GetRenderPosition() const {
+        float t = DeltaTime::GetInterpolation();
+        return Vector2{
+            previousPosition.x + (position.x - previousPosition.x) * t,
+            previousPosition.y + (position.y - previousPosition.y) * t
+        };
+    }
+
+    float GetRenderRotation() const {
+        float t = DeltaTime::GetInterpolation();
+        float delta = std::remainder(rotation - previousRotation, 360.0f);
+        return previousRotation + delta * t;
+    }
+
+private:
+    // Holds a component until the entity joins a scene
+    template<typename T>
+    void AddPending(std::shared_ptr<T> component) {
+        for (auto& p : pending) {
+            if (p.type == ComponentTypes::Id<T>()) {
+                p.component = component;
+                return;
+            }
+        }
+        pending.push_back(PendingComponent{
+            ComponentTypes::Id<T>(),
+            component,
+            [](Registry& owner, EntityId entityId, std::shared_ptr<void>& c) {
+                owner.AddComponent<T>(entityId, std::move(*std::static_pointer_cast<T>(c)));
+            }
+        });
+    }
+
+public:
+    // Components are stored by type, one per type per entity, and moved
+    // into the scene's per-type pool. The name is only registered as an
+    // alias for HasComponent(name) lookups.
+    template<typename T>
+    void AddComponent(const std::string& name, T component) {
+        ComponentTypes::Alias(name, ComponentTypes::Id<T>());
+        if (registry) {
+            registry->AddComponent<T>(id, std::move(component));
+            return;
+        }
+        AddPending(std::make_shared<T>(std::move(component)));
+    }
+
+    // Legacy form. The argument is consumed: its value is moved into the
+    // pool, and changes made through the caller's shared_ptr afterwards are
+    // not seen by the entity. Use GetComponent to reach the stored copy.
+    template<typename T>
+    [[deprecated("the component is moved into the scene's pool; pass it by value and use GetComponent")]]
+    void AddComponent(const std::string& name, std::shared_ptr<T> component) {
+        ComponentTypes::Alias(name, ComponentTypes::Id<T>());
+        if (registry) {
+            registry->AddComponent<T>(id, std::move(*component));
+            return;
+        }
+        AddPending(std::move(component));
+    }
+
+    // nullptr if missing. Components live in a dense per-type pool, so the
+    // pointer is invalidated by any insert into or removal from T's pool
+    // (adding or removing a T on any entity, or destroying an entity that
+    // has one); look it up again rather than keeping it across those.
+    template<typename T>
+    T* GetComponent() {
+        if (registry) {
+            return registry->GetComponent<T>(id);
+        }
+        for (auto& p : pending) {
+            if (p.type == ComponentTypes::Id<T>()) {
+                return static_cast<T*>(p.component.get());
+            }
+        }
+        return nullptr;
+    }
+
+    template<typename T>
+    T* GetComponent(const std::string& name) {
+        (void)name;
+        return GetComponent<T>();
+    }
+
+    template<typename T>
+    bool HasComponent() {
+        return GetComponent<T>() != nullptr;
+    }
+
+    bool HasComponent(const std::string& name) {
+        ComponentId type;
+        if (!ComponentTypes::Find(name, type)) return false;
+        if (registry) return (registry->GetMask(id) & (ComponentMask{1} << type)) != 0;
+        for (auto& p : pending) {
+            if (p.type == type) return true;
+        }
+        return false;
+    }
+
+    // Component updates run per type in Scene::Update; this only integrates motion.
+    virtual void Update() {
+        // Apply acceleration
+        velocity.x += acceleration.x * DeltaTime::Get();
+        velocity.y += acceleration.y * DeltaTime::Get();
+        
+        // Apply velocity
+        position.x += velocity.x * DeltaTime::Get();
+        position.y += velocity.y * DeltaTime::Get();
+    }
+
+    // Submits the entity to the scene's batch. Overrides may also issue
+    // immediate raylib draw calls; those land underneath batched geometry.
+    virtual void Draw(RenderBatch& batch) {
+        Vector2 renderPosition = GetRenderPosition();
+        float renderRotation = GetRenderRotation();
+
+        // Draw sprite or animation
+        if (auto anim = GetComponent<AnimationComponent>()) {
+            Rectangle dest{renderPosition.x, renderPosition.y, size.x, size.y};
+            if (anim->sheet) {
+                batch.DrawSprite(anim->sheet.Get(), anim->frameRect, dest, Vector2{size.x/2, size.y/2},
+                                 renderRotation, color, RenderBatch::EntityLayer);
+            } else if (anim->atlasSprite) {
+                batch.DrawSpriteUV(anim->spriteSheet, anim->atlasSprite->frames[anim->currentFrame],
+                                   dest, Vector2{size.x/2, size.y/2}, renderRotation, color,
+                                   RenderBatch::EntityLayer);
+            } else {
+                batch.DrawSprite(anim->spriteSheet, anim->frameRect, dest, Vector2{size.x/2, size.y/2},
+                                 renderRotation, color, RenderBatch::EntityLayer);
+            }
+        } else if (auto animator = GetComponent<Animator>()) {
+            const AnimationClip& clip = AnimationLibrary::Clip(animator->clip);
+            Rectangle dest{renderPosition.x, renderPosition.y, size.x, size.y};
+            if (!clip.uvs.empty()) {
+                batch.DrawSpriteUV(clip.texture, clip.uvs[animator->frame], dest, Vector2{size.x/2, size.y/2},
+                                   renderRotation, color, RenderBatch::EntityLayer);
+            } else {
+                batch.DrawSprite(clip.texture, clip.frames[animator->frame], dest, Vector2{size.x/2, size.y/2},
+                                 renderRotation, color, RenderBatch::EntityLayer);
+            }
+        } else {
+            batch.DrawQuad(
+                Rectangle{renderPosition.x, renderPosition.y, size.x, size.y},
+                Vector2{size.x/2, size.y/2},
+                renderRotation,
+                color,
+                RenderBatch::EntityLayer
+            );
+        }
+    }
+    
+    bool CheckCollision(const Entity& other) {
+        return CheckCollisionRecs(GetBounds(), other.GetBounds());
+    }
+
+    Rectangle GetBounds() const {
+        return Rectangle{
+            position.x - size.x/2,
+            position.y - size.y/2,
+            size.x,
+            size.y
+        };
+    }
+};
+
+enum class Broadphase {
+    Grid, // Hashed uniform grid rebuilt every frame; best for many similar-sized movers
+    Tree  // Incremental dynamic AABB tree; best for large static geometry and sparse movers
+};
+
+class Scene {
+private:
+    // Shared with every entity spawned into it (through the allocator in
+    // its control block), so the slabs outlive the last reference
+    std::shared_ptr<SlabPools> entitySlabs = std::make_shared<SlabPools>();
+    Registry registry;
+    ParticleSystem particles;
+    RenderBatch renderBatch;
+    Broadphase broadphase = Broadphase::Grid;
+    SpatialGrid spatialGrid;
+    std::vector<Entity*> indexedEntities;
+    DynamicAABBTree aabbTree;
+    std::vector<int32_t> treeProxies; // By entity slot index
+    std::vector<std::shared_ptr<Entity>> entities;
+    std::vector<std::vector<Entity*>> taggedEntities; // By TagId
+    std::vector<EntityId> destroyQueue;
+    std::pmr::memory_resource* frameResource = std::pmr::new_delete_resource();
+
+    // View culling. Entities the spatial index can't return (no collision
+    // layers, or added since the last index rebuild) are tested one by one.
+    Camera2D camera{};
+    bool hasCamera = false;
+    bool cullAnimations = false;
+    float cullMargin = 64.0f;
+    Vector2 viewportSize{0, 0};
+    std::vector<Entity*> unindexedEntities;
+    std::vector<Entity*> visibleEntities;
+    std::mutex destroyMutex;
+
+    struct System {
+        std::string name;
+        std::function<void(Scene&)> run;
+        std::vector<std::string> after;
+        const char* zoneName;
+    };
+
+    JobSystem* jobs = &JobSystem::Default();
+    bool parallelEntityUpdate = false;
+    Rng emitterRng;
+    uint32_t emitterRngGeneration = 0;
+    std::vector<System> systems;
+    std::vector<std::vector<size_t>> systemLevels;
+    bool systemsDirty = true;
+
+    // Groups systems into levels: every system runs after all systems in
+    // earlier levels, and systems within a level may run concurrently.
+    void BuildSystemLevels() {
+        std::vector<int> level(systems.size(), -1);
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (size_t i = 0; i < systems.size(); i++) {
+                if (level[i] >= 0) continue;
+                int depth = 0;
+                bool ready = true;
+                for (const auto& dependency : systems[i].after) {
+                    for (size_t j = 0; j < systems.size(); j++) {
+                        if (systems[j].name != dependency) continue;
+                        if (level[j] < 0) ready = false;
+                        else depth = std::max(depth, level[j] + 1);
+                    }
+                }
+                if (ready) {
+                    level[i] = depth;
+                    progress = true;
+                }
+            }
+        }
+        systemLevels.clear();
+        for (size_t i = 0; i < systems.size(); i++) {
+            assert(level[i] >= 0 && "system dependency cycle");
+            if (level[i] < 0) continue;
+            if (static_cast<size_t>(level[i]) >= systemLevels.size()) systemLevels.resize(level[i] + 1);
+            systemLevels[level[i]].push_back(i);
+        }
+        systemsDirty = false;
+    }
+
+    void RunSystems() {
+        if (systemsDirty) BuildSystemLevels();
+        for (const auto& levelSystems : systemLevels) {
+            jobs->ParallelFor(levelSystems.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    const System& system = systems[levelSystems[i]];
+                    PROFILE_ZONE(system.zoneName);
+                    system.run(*this);
+                }
+            });
+        }
+    }
+
+    // Built-in stages
+    void UpdateEntities() {
+        // Serial unless SetParallelEntityUpdate opted in; entities spawned
+        // during the loop first update next tick
+        size_t count = entities.size();
+        auto run = [&](size_t begin, size_t end) {
+            PROFILE_ZONE("Entity::Update chunk");
+            for (size_t i = begin; i < end; i++) {
+                Entity& entity = *entities[i];
+                entity.SavePreviousState();
+                if (entity.active && !entity.sleeping) entity.Update();
+            }
+        };
+        if (parallelEntityUpdate) {
+            jobs->ParallelFor(count, 512, run);
+        } else {
+            run(0, count);
+        }
+        PROFILE_ZONE("Destroy flush");
+        for (size_t i = 0; i < count; i++) {
+            if (!entities[i]->active) Destroy(*entities[i]);
+        }
+        FlushDestroyQueue();
+    }
+
+    // Runs fn(Entity&, T&) over T's dense pool, skipping inactive and
+    // sleeping entities.
+    // Chunks go to the job system when `parallel` is set.
+    template<typename T, typename Fn>
+    void UpdateComponents(const Fn& fn, bool parallel, [[maybe_unused]] const char* zone) {
+        ComponentPool<T>* pool = registry.Pool<T>();
+        if (!pool) return;
+        auto run = [&](size_t begin, size_t end) {
+            PROFILE_ZONE(zone);
+            for (size_t i = begin; i < end; i++) {
+                Entity* entity = registry.GetByIndex(pool->OwnerAt(i));
+                if (entity && entity->active && !entity->sleeping) fn(*entity, pool->At(i));
+            }
+        };
+        if (parallel) {
+            jobs->ParallelFor(pool->Size(), 1024, run);
+        } else {
+            run(0, pool->Size());
+        }
+    }
+
+    // Per-instance AnimationComponents and shared-clip Animators, each in
+    // one batch over its pool
+    void UpdateAnimations() {
+        static const char* zone = Profiler::Intern("animation chunk");
+        const float dt = DeltaTime::Get();
+        if (!cullAnimations || !hasCamera) {
+            UpdateComponents<AnimationComponent>([](Entity&, AnimationComponent& animation) {
+                animation.Update();
+            }, true, zone);
+            UpdateComponents<Animator>([dt](Entity&, Animator& animator) {
+                AnimationLibrary::Advance(animator, dt);
+            }, true, zone);
+            return;
+        }
+        const Rectangle visible = GetVisibleRect();
+        UpdateComponents<AnimationComponent>([&visible](Entity& entity, AnimationComponent& animation) {
+            if (CheckCollisionRecs(visible, entity.GetBounds())) animation.Update();
+        }, true, zone);
+        UpdateComponents<Animator>([&visible, dt](Entity& entity, Animator& animator) {
+            if (CheckCollisionRecs(visible, entity.GetBounds())) AnimationLibrary::Advance(animator, dt);
+        }, true, zone);
+    }
+
+    void UpdateParticles() {
+        {
+            PROFILE_ZONE("ParticleSystem::Update");
+            particles.Update(DeltaTime::Get(), *jobs);
+        }
+        // Emitters append to the shared particle pool, so they run serially,
+        // drawing from the scene's own stream: Random::Local() would depend
+        // on which worker picked up this stage. Reseeded whenever Random
+        // is, e.g. by StartRecording and Replay.
+        if (emitterRngGeneration != Random::Generation()) {
+            emitterRngGeneration = Random::Generation();
+            emitterRng.Seed(Random::GetSeed() ^ 0x9e3779b97f4a7c15ull);
+        }
+        UpdateComponents<ParticleEmitter>([this](Entity& entity, ParticleEmitter& emitter) {
+            emitter.Update(entity.position, particles, emitterRng);
+        }, false, "ParticleEmitter::Update");
+    }
+
+    // Removes every queued entity with swap-and-pop, so a mass death costs
+    // O(deaths) rather than O(deaths * entities). Entity order in
+    // GetEntities() is not preserved across removals.
+    void FlushDestroyQueue() {
+        for (EntityId id : destroyQueue) {
+            Entity* entity = registry.Get(id);
+            if (!entity) continue;
+            RemoveFromTagIndex(*entity);
+            RemoveFromSpatialIndex(*entity);
+            RemoveFromSpatialLists(*entity);
+            registry.Destroy(id);
+            entity->registry = nullptr;
+
+            uint32_t slot = entity->sceneSlot;
+            if (slot + 1 != entities.size()) {
+                entities[slot] = std::move(entities.back());
+                entities[slot]->sceneSlot = slot;
+            }
+            entities.pop_back();
+        }
+        destroyQueue.clear();
+    }
+
+    void AddToTagIndex(Entity& entity) {
+        entity.tagId = Tags::Intern(entity.tag);
+        if (entity.tagId == Tags::None) return;
+        if (entity.tagId >= taggedEntities.size()) taggedEntities.resize(entity.tagId + 1);
+        auto& list = taggedEntities[entity.tagId];
+        entity.tagSlot = static_cast<uint32_t>(list.size());
+        list.push_back(&entity);
+    }
+
+    void RemoveFromTagIndex(Entity& entity) {
+        if (entity.tagId == Tags::None) return;
+        auto& list = taggedEntities[entity.tagId];
+        Entity* moved = list.back();
+        list[entity.tagSlot] = moved;
+        moved->tagSlot = entity.tagSlot;
+        list.pop_back();
+        entity.tagId = Tags::None;
+    }
+
+    int32_t& TreeProxy(const Entity& entity) {
+        uint32_t index = entity.GetId().index;
+        if (index >= treeProxies.size()) treeProxies.resize(index + 1, DynamicAABBTree::Null);
+        return treeProxies[index];
+    }
+
+    void AddUnindexed(Entity& entity) {
+        entity.unindexedSlot = static_cast<uint32_t>(unindexedEntities.size());
+        unindexedEntities.push_back(&entity);
+    }
+
+    // Queries and culled draws between a flush and the next index rebuild
+    // must not see freed entities: grid entries become null, and the
+    // unindexed list is swap-removed
+    void RemoveFromSpatialLists(Entity& entity) {
+        if (entity.gridSlot < indexedEntities.size() && indexedEntities[entity.gridSlot] == &entity) {
+            indexedEntities[entity.gridSlot] = nullptr;
+        }
+        uint32_t slot = entity.unindexedSlot;
+        if (slot < unindexedEntities.size() && unindexedEntities[slot] == &entity) {
+            Entity* moved = unindexedEntities.back();
+            unindexedEntities[slot] = moved;
+            moved->unindexedSlot = slot;
+            unindexedEntities.pop_back();
+        }
+        entity.gridSlot = UINT32_MAX;
+        entity.unindexedSlot = UINT32_MAX;
+    }
+
+    void RemoveFromSpatialIndex(Entity& entity) {
+        if (broadphase != Broadphase::Tree) return;
+        int32_t& proxy = TreeProxy(entity);
+        if (proxy != DynamicAABBTree::Null) {
+            aabbTree.DestroyProxy(proxy);
+            proxy = DynamicAABBTree::Null;
+        }
+    }
+
+    void UpdateSpatialIndex() {
+        PROFILE_ZONE("Spatial index");
+        unindexedEntities.clear();
+        for (auto& entity : entities) {
+            if (entity->active && entity->collisionLayers == 0) AddUnindexed(*entity);
+        }
+        if (broadphase == Broadphase::Tree) {
+            float dt = DeltaTime::Get();
+            for (auto& entity : entities) {
+                int32_t& proxy = TreeProxy(*entity);
+                if (!entity->active) {
+                    RemoveFromSpatialIndex(*entity);
+                } else if (proxy == DynamicAABBTree::Null) {
+                    proxy = aabbTree.CreateProxy(entity->GetBounds(), entity->collisionLayers, entity->GetId().index);
+                } else {
+                    Vector2 displacement{entity->velocity.x * dt, entity->velocity.y * dt};
+                    aabbTree.MoveProxy(proxy, entity->GetBounds(), displacement, entity->collisionLayers);
+                }
+            }
+            return;
+        }
+
+        spatialGrid.Clear();
+        indexedEntities.clear();
+        for (auto& entity : entities) {
+            if (!entity->active) continue;
+            spatialGrid.Add(entity->GetBounds(), entity->collisionLayers);
+            entity->gridSlot = static_cast<uint32_t>(indexedEntities.size());
+            indexedEntities.push_back(entity.get());
+        }
+        spatialGrid.Build();
+    }
+
+    void DrawVisible() {
+        Rectangle visible = GetVisibleRect();
+        {
+            PROFILE_ZONE("Particles");
+            particles.Draw(renderBatch, visible, RenderBatch::ParticleLayer);
+        }
+
+        PROFILE_ZONE("Entities");
+        visibleEntities.clear();
+        QueryAABB(visible, [this](Entity& entity) { visibleEntities.push_back(&entity); });
+        for (Entity* entity : unindexedEntities) {
+            if (entity->active && CheckCollisionRecs(visible, entity->GetBounds())) {
+                visibleEntities.push_back(entity);
+            }
+        }
+        // Keep scene order so overlapping sprites stack the same as unculled
+        std::sort(visibleEntities.begin(), visibleEntities.end(), [](const Entity* a, const Entity* b) {
+            return a->sceneSlot < b->sceneSlot;
+        });
+        for (Entity* entity : visibleEntities) entity->Draw(renderBatch);
+    }
+
+    Entity* TreeEntity(int32_t proxy) const {
+        return registry.GetByIndex(aabbTree.GetUserData(proxy));
+    }
+
+public:
+    static constexpr uint32_t AllLayers = UINT32_MAX;
+
+    Scene() {
+        AddSystem("movement", [](Scene& scene) { scene.UpdateEntities(); }, {});
+        AddSystem("animation", [](Scene& scene) { scene.UpdateAnimations(); }, {"movement"});
+        AddSystem("particles", [](Scene& scene) { scene.UpdateParticles(); }, {"movement"});
+        // Movement -> particles -> collision; collision reads final bounds,
+        // so it also waits for animation
+        AddSystem("collision", [](Scene& scene) { scene.UpdateSpatialIndex(); }, {"particles", "animation"});
+    }
+
+    // Entities still referenced from outside (copies of GetEntities
+    // pointers) survive as detached objects with no components
+    ~Scene() {
+        for (auto& entity : entities) entity->registry = nullptr;
+    }
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Registers a per-frame system that runs after the named systems.
+    // Built-ins: "movement", then "animation" and "particles" (which may
+    // run concurrently), then "collision". By default a system runs after
+    // "movement", which flushes destroyed entities and so reshapes the
+    // entity list and component pools. A system given an empty list shares
+    // level 0 with "movement" and must not touch entities, components or
+    // particles.
+    void AddSystem(const std::string& name, std::function<void(Scene&)> run,
+                   std::vector<std::string> after = {"movement"}) {
+        systems.push_back(System{name, std::move(run), std::move(after), Profiler::Intern(name)});
+        systemsDirty = true;
+    }
+
+    // Registers a system that updates every component of type T in one
+    // batch over T's pool. fn(Entity&, T&) is inlined into the loop, so the
+    // only indirect call is one per type per tick, and a new component type
+    // needs no changes to Entity or Scene. With `parallel` the pool is split
+    // into chunks on the job system, and fn may then touch only its own
+    // entity and component. Like AddSystem, it runs after "movement" by
+    // default so the pool is not compacted underneath it.
+    template<typename T, typename Fn>
+    void AddComponentSystem(const std::string& name, Fn fn, std::vector<std::string> after = {"movement"},
+                            bool parallel = false) {
+        const char* zone = Profiler::Intern(name + " chunk");
+        AddSystem(name, [fn, parallel, zone](Scene& scene) {
+            scene.UpdateComponents<T>(fn, parallel, zone);
+        }, std::move(after));
+    }
+
+    void SetJobSystem(JobSystem& jobSystem) { jobs = &jobSystem; }
+
+    // Runs Entity::Update in parallel chunks on the job system. Only for
+    // entity types whose Update touches nothing but their own entity: no
+    // reading other entities, spawning, destroying others or shared state.
+    void SetParallelEntityUpdate(bool enabled) { parallelEntityUpdate = enabled; }
+    JobSystem& GetJobSystem() { return *jobs; }
+    void AddEntity(std::shared_ptr<Entity> entity) {
+        entity->Attach(registry, registry.Create(entity.get()));
+        entity->sceneSlot = static_cast<uint32_t>(entities.size());
+        entity->destroyQueued = false;
+        entity->SavePreviousState();
+        AddUnindexed(*entity);
+        entities.push_back(entity);
+        AddToTagIndex(*entity);
+    }
+
+    // Constructs a T in the scene's entity slabs and adds it, so entities of
+    // one type are stored contiguously. The scene owns the result: keep its
+    // EntityId (GetId) rather than the pointer, which dangles once the
+    // entity is destroyed.
+    template<typename T, typename... Args>
+    T* Spawn(Args&&... args) {
+        static_assert(std::is_base_of_v<Entity, T>, "Spawn creates Entity subclasses");
+        auto entity = std::allocate_shared<T>(SlabAllocator<T>(entitySlabs), std::forward<Args>(args)...);
+        T* raw = entity.get();
+        AddEntity(std::move(entity));
+        return raw;
+    }
+
+    // Deactivates the entity now and removes it at the next flush. Ids of
+    // destroyed entities go stale: GetEntity/IsAlive report them as gone even
+    // after their slot is reused.
+    void Destroy(Entity& entity) {
+        std::lock_guard<std::mutex> lock(destroyMutex);
+        entity.active = false;
+        if (entity.destroyQueued || !registry.IsAlive(entity.id)) return;
+        entity.destroyQueued = true;
+        destroyQueue.push_back(entity.id);
+    }
+
+    void Destroy(EntityId id) {
+        if (Entity* entity = registry.Get(id)) Destroy(*entity);
+    }
+
+    bool IsAlive(EntityId id) const {
+        return registry.IsAlive(id);
+    }
+
+    // Hash of the simulation state after the last tick: every active
+    // entity's core fields in scene order, every live particle, and the
+    // saved fields of Snapshot-registered component types (ParticleEmitter
+    // and Animator are built in). Entity subclass members and unregistered
+    // components are not covered. Two runs that agree on every tick's hash
+    // took the same path.
+    uint64_t StateHash();
+
+    // Retags an entity (assigning Entity::tag directly only takes effect
+    // when the entity is added). For an entity not in this scene only the
+    // tag is stored; AddEntity indexes it.
+    void SetTag(Entity& entity, const std::string& tag) {
+        if (registry.Get(entity.id) != &entity) {
+            entity.tag = tag;
+            return;
+        }
+        RemoveFromTagIndex(entity);
+        entity.tag = tag;
+        AddToTagIndex(entity);
+    }
+
+    // Removes every entity and particle right away
+    void Clear() {
+        for (auto& entity : entities) Destroy(*entity);
+        FlushDestroyQueue();
+        particles.Clear();
+    }
+
+    EntityRange EntitiesWithTag(TagId tag) const {
+        if (tag == Tags::None || tag >= taggedEntities.size()) return EntityRange();
+        const auto& list = taggedEntities[tag];
+        return EntityRange(list.data(), list.data() + list.size());
+    }
+
+    EntityRange EntitiesWithTag(const std::string& tag) const {
+        return EntitiesWithTag(Tags::Find(tag));
+    }
+
+    // Legacy copying query; prefer EntitiesWithTag in per-frame code. The
+    // copies keep their entities' memory alive past Destroy, Clear or the
+    // scene itself, but such entities are detached: not in any query and
+    // without components.
+    std::vector<std::shared_ptr<Entity>> GetEntitiesByTag(const std::string& tag) {
+        std::vector<std::shared_ptr<Entity>> result;
+        TagId id = Tags::Find(tag);
+        if (id == Tags::None) return result;
+        for (auto& entity : entities) {
+            if (entity->tagId == id) result.push_back(entity);
+        }
+        return result;
+    }
+
+    Entity* GetEntity(EntityId id) const {
+        return registry.Get(id);
+    }
+
+    template<typename... Ts, typename Fn>
+    void Each(Fn&& fn) {
+        registry.Each<Ts...>(std::forward<Fn>(fn));
+    }
+
+    Registry& GetRegistry() { return registry; }
+    ParticleSystem& GetParticleSystem() { return particles; }
+    RenderBatch& GetRenderBatch() { return renderBatch; }
+    SpatialGrid& GetSpatialGrid() { return spatialGrid; }
+    DynamicAABBTree& GetAABBTree() { return aabbTree; }
+
+    void SetBroadphase(Broadphase type) {
+        if (type == broadphase) return;
+        if (broadphase == Broadphase::Tree) {
+            for (auto& entity : entities) RemoveFromSpatialIndex(*entity);
+        }
+        broadphase = type;
+        UpdateSpatialIndex();
+    }
+
+    Broadphase GetBroadphase() const { return broadphase; }
+
+    // Spatial queries see entity bounds as of the end of the last Update;
+    // entities added since then are not indexed yet.
+    template<typename Fn>
+    void QueryAABB(const Rectangle& area, Fn&& fn, uint32_t layerMask = AllLayers) {
+        if (broadphase == Broadphase::Tree) {
+            aabbTree.QueryAABB(area, layerMask, [&](int32_t proxy) {
+                Entity* entity = TreeEntity(proxy);
+                if (entity->active) fn(*entity);
+            });
+            return;
+        }
+        spatialGrid.QueryAABB(area, layerMask, [&](uint32_t i) {
+            Entity* entity = indexedEntities[i];
+            if (entity && entity->active) fn(*entity);
+        });
+    }
+
+    template<typename Fn>
+    void QueryRadius(Vector2 center, float radius, Fn&& fn, uint32_t layerMask = AllLayers) {
+        if (broadphase == Broadphase::Tree) {
+            aabbTree.QueryRadius(center, radius, layerMask, [&](int32_t proxy) {
+                Entity* entity = TreeEntity(proxy);
+                if (entity->active) fn(*entity);
+            });
+            return;
+        }
+        spatialGrid.QueryRadius(center, radius, layerMask, [&](uint32_t i) {
+            Entity* entity = indexedEntities[i];
+            if (entity && entity->active) fn(*entity);
+        });
+    }
+
+    // fn(a, b) once per overlapping pair, with a in layerMaskA and b in layerMaskB
+    template<typename Fn>
+    void ForEachOverlappingPair(Fn&& fn, uint32_t layerMaskA = AllLayers, uint32_t layerMaskB = AllLayers) {
+        if (broadphase == Broadphase::Tree) {
+            aabbTree.ForEachOverlappingPair(layerMaskA, layerMaskB, [&](int32_t a, int32_t b) {
+                Entity* entityA = TreeEntity(a);
+                Entity* entityB = TreeEntity(b);
+                if (entityA->active && entityB->active) fn(*entityA, *entityB);
+            });
+            return;
+        }
+        spatialGrid.ForEachOverlappingPair(layerMaskA, layerMaskB, [&](uint32_t a, uint32_t b) {
+            Entity* entityA = indexedEntities[a];
+            Entity* entityB = indexedEntities[b];
+            if (entityA && entityB && entityA->active && entityB->active) fn(*entityA, *entityB);
+        });
+    }
+
+    // Collecting variants of the queries above. The results are allocated
+    // from the frame resource (the engine's frame arena when the scene is
+    // owned by a GameEngine), so they must not be kept past the frame.
+    FrameVector<Entity*> CollectAABB(const Rectangle& area, uint32_t layerMask = AllLayers) {
+        FrameVector<Entity*> result(frameResource);
+        QueryAABB(area, [&](Entity& entity) { result.push_back(&entity); }, layerMask);
+        return result;
+    }
+
+    FrameVector<Entity*> CollectRadius(Vector2 center, float radius, uint32_t layerMask = AllLayers) {
+        FrameVector<Entity*> result(frameResource);
+        QueryRadius(center, radius, [&](Entity& entity) { result.push_back(&entity); }, layerMask);
+        return result;
+    }
+
+    FrameVector<std::pair<Entity*, Entity*>> CollectOverlappingPairs(uint32_t layerMaskA = AllLayers,
+                                                                     uint32_t layerMaskB = AllLayers) {
+        FrameVector<std::pair<Entity*, Entity*>> result(frameResource);
+        ForEachOverlappingPair([&](Entity& a, Entity& b) { result.emplace_back(&a, &b); },
+                               layerMaskA, layerMaskB);
+        return result;
+    }
+
+    void SetFrameResource(std::pmr::memory_resource* resource) {
+        frameResource = resource ? resource : std::pmr::new_delete_resource();
+    }
+
+    std::pmr::memory_resource* GetFrameResource() const { return frameResource; }
+
+    struct Hit {
+        Entity* entity = nullptr;
+        float fraction = 1.0f; // Along the ray/sweep, in [0, 1]
+    };
+
+    // Closest entity whose bounds box swept by delta touches; a zero-size
+    // box makes this a raycast. `ignore` is skipped (e.g. the mover itself).
+    Hit Sweep(const Rectangle& box, Vector2 delta, uint32_t layerMask = AllLayers, const Entity* ignore = nullptr) {
+        Hit closest;
+        auto consider = [&](Entity& entity, float t) {
+            if (&entity == ignore || !entity.active || t >= closest.fraction) return;
+            closest.entity = &entity;
+            closest.fraction = t;
+        };
+        if (broadphase == Broadphase::Tree) {
+            aabbTree.Sweep(box, delta, layerMask, [&](int32_t proxy, float t) {
+                consider(*TreeEntity(proxy), t);
+                return closest.fraction;
+            });
+            return closest;
+        }
+
+        Rectangle area{
+            std::min(box.x, box.x + delta.x), std::min(box.y, box.y + delta.y),
+            box.width + std::fabs(delta.x), box.height + std::fabs(delta.y)
+        };
+        float hw = box.width * 0.5f, hh = box.height * 0.5f;
+        Vector2 center{box.x + hw, box.y + hh};
+        spatialGrid.QueryAABB(area, layerMask, [&](uint32_t i) {
+            if (!indexedEntities[i]) return;
+            Rectangle b = indexedEntities[i]->GetBounds();
+            Rectangle expanded{b.x - hw, b.y - hh, b.width + box.width, b.height + box.height};
+            float t;
+            if (RaycastRect(center, delta, expanded, 1.0f, t)) consider(*indexedEntities[i], t);
+        });
+        return closest;
+    }
+
+    Hit Raycast(Vector2 from, Vector2 to, uint32_t layerMask = AllLayers, const Entity* ignore = nullptr) {
+        return Sweep(Rectangle{from.x, from.y, 0, 0}, Vector2{to.x - from.x, to.y - from.y}, layerMask, ignore);
+    }
+
+    // With a camera set, Draw only submits entities and particles inside
+    // the camera's view of the viewport (see SetViewportSize), padded by
+    // the cull margin to cover render interpolation and sprites larger
+    // than their bounds. Drawing still happens in world space: the caller
+    // (GameEngine::Draw) wraps it in BeginMode2D.
+    void SetCamera(const Camera2D& view) {
+        camera = view;
+        hasCamera = true;
+    }
+
+    void ClearCamera() { hasCamera = false; }
+    bool HasCamera() const { return hasCamera; }
+    const Camera2D& GetCamera() const { return camera; }
+
+    void SetViewportSize(float width, float height) { viewportSize = Vector2{width, height}; }
+    void SetCullMargin(float margin) { cullMargin = margin; }
+
+    // Off-screen animations freeze instead of advancing (camera required)
+    void SetCullAnimations(bool enabled) { cullAnimations = enabled; }
+
+    // World-space AABB of the viewport as seen through the camera
+    Rectangle GetVisibleRect() const {
+        if (!hasCamera) return Rectangle{0, 0, viewportSize.x, viewportSize.y};
+        float zoom = camera.zoom != 0.0f ? camera.zoom : 1.0f;
+        float c = cosf(-camera.rotation * DEG2RAD);
+        float s = sinf(-camera.rotation * DEG2RAD);
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        const Vector2 corners[] = {
+            {0, 0}, {viewportSize.x, 0}, {0, viewportSize.y}, {viewportSize.x, viewportSize.y}
+        };
+        for (const Vector2& corner : corners) {
+            float x = (corner.x - camera.offset.x) / zoom;
+            float y = (corner.y - camera.offset.y) / zoom;
+            float worldX = camera.target.x + x * c - y * s;
+            float worldY = camera.target.y + x * s + y * c;
+            minX = std::min(minX, worldX);
+            maxX = std::max(maxX, worldX);
+            minY = std::min(minY, worldY);
+            maxY = std::max(maxY, worldY);
+        }
+        return Rectangle{minX - cullMargin, minY - cullMargin,
+                         maxX - minX + 2 * cullMargin, maxY - minY + 2 * cullMargin};
+    }
+
+    bool IsVisible(const Entity& entity) const {
+        return CheckCollisionRecs(GetVisibleRect(), entity.GetBounds());
+    }
+
+    // Advances the simulation by one step of dt seconds
+    void Update(float dt) {
+        PROFILE_ZONE("Scene::Update");
+        DeltaTime::Set(dt);
+        RunSystems();
+    }
+
+    // Variable step: advances by the measured frame time
+    void Update() {
+        PROFILE_ZONE("Scene::Update");
+        DeltaTime::Update();
+        DeltaTime::SetInterpolation(1.0f);
+        RunSystems();
+    }
+
+    void Draw() {
+        PROFILE_ZONE("Scene::Draw");
+        if (hasCamera) {
+            DrawVisible();
+        } else {
+            {
+                // Particles sit underneath the entities
+                PROFILE_ZONE("Particles");
+                particles.Draw(renderBatch, RenderBatch::ParticleLayer);
+            }
+            PROFILE_ZONE("Entities");
+            for(auto& entity : entities) {
+                if(entity->active) {
+                    entity->Draw(renderBatch);
+                }
+            }
+        }
+        PROFILE_ZONE("RenderBatch::Flush");
+        renderBatch.Flush();
+    }
+
+    // Every entity in the scene. Copied pointers behave as described for
+    // GetEntitiesByTag.
+    std::vector<std::shared_ptr<Entity>>& GetEntities() {
+        return entities;
+    }
+};
+
+// Byte-oriented LZ77 in the LZ4 block layout: each sequence is a token
+// (literal run and match length, 15 meaning "more length bytes follow"),
+// the literals, a 16-bit little-endian back offset and any extra match
+// length; the last sequence is literals only. Decoding is a few branches
+// and memcpys per sequence, and checks every length and offset, so a
+// corrupt block fails instead of overrunning either buffer.
+namespace Lz {
+    constexpr size_t MinMatch = 4;
+    constexpr size_t MaxOffset = 65535;
+    constexpr size_t TailLiterals = 5; // Matches stop this far from the end
+
+    inline uint32_t Read32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline void WriteLength(std::vector<uint8_t>& out, size_t length) {
+        for (; length >= 255; length -= 255) out.push_back(255);
+        out.push_back(static_cast<uint8_t>(length));
+    }
+
+    inline void WriteSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount,
+                              size_t offset, size_t matchLength) {
+        const size_t extra = matchLength - MinMatch;
+        out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) |
+                                           std::min<size_t>(extra, 15)));
+        if (literalCount >= 15) WriteLength(out, literalCount - 15);
+        out.insert(out.end(), literals, literals + literalCount);
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (extra >= 15) WriteLength(out, extra - 15);
+    }
+
+    // Appends the compressed form of src to out
+    inline void Compress(const uint8_t* src, size_t size, std::vector<uint8_t>& out) {
+        constexpr int HashBits = 16;
+        std::vector<uint32_t> table(size_t{1} << HashBits, 0); // Position + 1; 0 is empty
+        const size_t limit = size > TailLiterals + MinMatch ? size - TailLiterals - MinMatch : 0;
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i < limit) {
+            const uint32_t sequence = Read32(src + i);
+            const uint32_t h = (sequence * 2654435761u) >> (32 - HashBits);
+            const size_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(i + 1);
+            if (candidate == 0 || i - (candidate - 1) > MaxOffset || Read32(src + candidate - 1) != sequence) {
+                i++;
+                continue;
+            }
+            const size_t match = candidate - 1;
+            size_t length = MinMatch;
+            while (i + length < size - TailLiterals && src[match + length] == src[i + length]) length++;
+            WriteSequence(out, src + anchor, i - anchor, i - match, length);
+            i += length;
+            anchor = i;
+        }
+        const size_t literalCount = size - anchor;
+        out.push_back(static_cast<uint8_t>(std::min<size_t>(literalCount, 15) << 4));
+        if (literalCount >= 15) WriteLength(out, literalCount - 15);
+        out.insert(out.end(), src + anchor, src + size);
+    }
+
+    // Decodes src into exactly dstSize bytes; false on malformed input
+    inline bool Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+        size_t ip = 0;
+        size_t op = 0;
+        auto readLength = [&](size_t& length) {
+            uint8_t byte;
+            do {
+                if (ip >= srcSize) return false;
+                byte = src[ip++];
+                length += byte;
+            } while (byte == 255);
+            return true;
+        };
+        while (ip < srcSize) {
+            const uint8_t token = src[ip++];
+            size_t literalCount = token >> 4;
+            if (literalCount == 15 && !readLength(literalCount)) return false;
+            if (literalCount > srcSize - ip || literalCount > dstSize - op) return false;
+            std::memcpy(dst + op, src + ip, literalCount);
+            ip += literalCount;
+            op += literalCount;
+            if (ip == srcSize) break;
+
+            if (srcSize - ip < 2) return false;
+            const size_t offset = src[ip] | (static_cast<size_t>(src[ip + 1]) << 8);
+            ip += 2;
+            size_t length = token & 15;
+            if (length == 15 && !readLength(length)) return false;
+            length += MinMatch;
+            if (offset == 0 || offset > op || length > dstSize - op) return false;
+            if (offset >= length) {
+                std::memcpy(dst + op, dst + op - offset, length);
+            } else {
+                for (size_t k = 0; k < length; k++) dst[op + k] = dst[op - offset + k];
+            }
+            op += length;
+        }
+        return op == dstSize;
+    }
+}
+
+// Read-only view of a whole file: memory-mapped where the platform has
+// mmap, otherwise read into a buffer.
+class MappedFile {
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+#ifdef GAME_ENGINE_HAS_MMAP
+    void* mapping = nullptr;
+#else
+    std::vector<uint8_t> buffer;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path) {
+        Close();
+#ifdef GAME_ENGINE_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                length = 0;
+                ::close(fd);
+                return false;
+            }
+            ::madvise(mapping, length, MADV_SEQUENTIAL);
+            bytes = static_cast<const uint8_t*>(mapping);
+        }
+        ::close(fd);
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) return false;
+        bytes = buffer.data();
+        length = buffer.size();
+        return true;
+#endif
+    }
+
+    void Close() {
+#ifdef GAME_ENGINE_HAS_MMAP
+        if (mapping) ::munmap(mapping, length);
+        mapping = nullptr;
+#else
+        buffer.clear();
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const uint8_t* Data() const { return bytes; }
+    size_t Size() const { return length; }
+};
+
+// Scene snapshots in a versioned, little-endian binary format.
+//
+// Every entity subclass and component type that goes into a snapshot
+// registers a schema: a name plus named, trivially copyable fields. The
+// schemas are written into the file and matched to the registered ones by
+// name when loading, so fields can be added, removed or reordered without
+// breaking old files (fields a file lacks keep their constructor values).
+// Entity and component records are fixed-size and copied field by field
+// out of the file, and EntityId fields are remapped to the ids the entities
+// get in the loading scene. Loading is not an in-place fix-up: every
+// entity is still constructed (Spawn) and every registered field copied,
+// because entities are polymorphic objects and pools own their storage.
+// What the format saves over text is parsing and allocation churn.
+//
+//   Snapshot::RegisterEntity<Enemy>("Enemy").Field("time", &Enemy::time);
+//   Snapshot::RegisterComponent<Health>("Health").Field("hp", &Health::hp);
+//   Snapshot::Save(scene, "level.snap", true);   // LZ-compressed
+//   Snapshot::Load("level.snap", otherScene);    // Appends to otherScene
+//
+// Inactive entities and particles are not saved. Animator clip ids and
+// particle preset ids are stored as-is, so register clips and presets in
+// the same order before loading. Register schemas at startup, before any
+// threads use them.
+class Snapshot {
+public:
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t CompressedFlag = 1;
+
+private:
+    enum class FieldKind : uint8_t { Plain, EntityRef };
+
+    struct FieldAccess {
+        std::string name;
+        uint32_t size = 0;
+        FieldKind kind = FieldKind::Plain;
+
+        virtual ~FieldAccess() = default;
+        virtual void Read(const void* object, uint8_t* out) const = 0;
+        virtual void Write(void* object, const uint8_t* in) const = 0;
+    };
+
+    template<typename T, typename M>
+    struct MemberField : FieldAccess {
+        M T::*member;
+
+        explicit MemberField(M T::*m) : member(m) {}
+        void Read(const void* object, uint8_t* out) const override {
+            std::memcpy(out, &(static_cast<const T*>(object)->*member), sizeof(M));
+        }
+        void Write(void* object, const uint8_t* in) const override {
+            if constexpr (std::is_same_v<M, bool>) {
+                static_cast<T*>(object)->*member = *in != 0; // Any other byte is not a valid bool
+            } else {
+                std::memcpy(&(static_cast<T*>(object)->*member), in, sizeof(M));
+            }
+        }
+    };
+
+public:
+    class Schema {
+    protected:
+        std::string name;
+        std::vector<std::unique_ptr<FieldAccess>> fields;
+        uint32_t recordSize = 0;
+
+        friend class Snapshot;
+
+        // Entity schemas
+        virtual Entity* Spawn(Scene&) const { return nullptr; }
+        virtual void* Object(Entity& entity) const { return &entity; }
+        // Component schemas: fn(entity slot, component) over the pool, or
+        // one entity's component (nullptr if it has none)
+        virtual void ForEach(Registry&, const std::function<void(uint32_t, const void*)>&) const {}
+        virtual const void* Find(Registry&, uint32_t) const { return nullptr; }
+        virtual size_t Count(Registry&) const { return 0; }
+        virtual void* Add(Registry&, EntityId) const { return nullptr; }
+
+    public:
+        virtual ~Schema() = default;
+        const std::string& Name() const { return name; }
+    };
+
+    template<typename T>
+    class TypedSchema : public Schema {
+    public:
+        // Adds a field; EntityId fields are remapped on load
+        template<typename M, typename Owner>
+        TypedSchema& Field(const std::string& fieldName, M Owner::*member) {
+            static_assert(std::is_base_of_v<Owner, T>, "field must belong to the registered type");
+            static_assert(std::is_trivially_copyable_v<M>, "snapshot fields are copied as raw bytes");
+            auto field = std::make_unique<MemberField<T, M>>(static_cast<M T::*>(member));
+            field->name = fieldName;
+            field->size = static_cast<uint32_t>(sizeof(M));
+            field->kind = std::is_same_v<M, EntityId> ? FieldKind::EntityRef : FieldKind::Plain;
+            this->recordSize += field->size;
+            this->fields.push_back(std::move(field));
+            return *this;
+        }
+    };
+
+private:
+    template<typename T>
+    class EntitySchema final : public TypedSchema<T> {
+    public:
+        std::function<T*(Scene&)> spawn;
+
+        Entity* Spawn(Scene& scene) const override { return spawn(scene); }
+        void* Object(Entity& entity) const override { return static_cast<T*>(&entity); }
+    };
+
+    template<typename T>
+    class ComponentSchema final : public TypedSchema<T> {
+    public:
+        void ForEach(Registry& registry, const std::function<void(uint32_t, const void*)>& fn) const override {
+            ComponentPool<T>* pool = registry.Pool<T>();
+            if (!pool) return;
+            for (size_t i = 0; i < pool->Size(); i++) fn(pool->OwnerAt(i), &pool->At(i));
+        }
+        const void* Find(Registry& registry, uint32_t slot) const override {
+            ComponentPool<T>* pool = registry.Pool<T>();
+            return pool ? pool->Get(slot) : nullptr;
+        }
+        size_t Count(Registry& registry) const override {
+            ComponentPool<T>* pool = registry.Pool<T>();
+            return pool ? pool->Size() : 0;
+        }
+        void* Add(Registry& registry, EntityId id) const override {
+            return &registry.AddComponent<T>(id, T{});
+        }
+    };
+
+    struct Table {
+        std::vector<std::unique_ptr<Schema>> entityTypes;
+        std::unordered_map<std::type_index, uint32_t> entityTypeIndex;
+        std::vector<std::unique_ptr<Schema>> componentTypes;
+
+        Table() {
+            AddEntity<Entity>(*this, "Entity", [](Scene& scene) { return scene.Spawn<Entity>(); });
+            AddComponent<ParticleEmitter>(*this, "ParticleEmitter")
+                .Field("offset", &ParticleEmitter::offset)
+                .Field("emitRate", &ParticleEmitter::emitRate)
+                .Field("emitTimer", &ParticleEmitter::emitTimer)
+                .Field("particleLifetime", &ParticleEmitter::particleLifetime)
+                .Field("particleColor", &ParticleEmitter::particleColor)
+                .Field("particleSpeed", &ParticleEmitter::particleSpeed)
+                .Field("emitting", &ParticleEmitter::emitting)
+                .Field("preset", &ParticleEmitter::preset)
+                .Field("pendingBurst", &ParticleEmitter::pendingBurst);
+            AddComponent<Animator>(*this, "Animator")
+                .Field("clip", &Animator::clip)
+                .Field("frame", &Animator::frame)
+                .Field("time", &Animator::time)
+                .Field("machine", &Animator::machine)
+                .Field("state", &Animator::state)
+                .Field("flags", &Animator::flags);
+        }
+    };
+
+    static Table& Get() {
+        static Table table;
+        return table;
+    }
+
+    template<typename T>
+    static TypedSchema<T>& AddEntity(Table& table, const std::string& name, std::function<T*(Scene&)> spawn) {
+        static_assert(std::is_base_of_v<Entity, T>, "entity schemas are for Entity subclasses");
+        auto schema = std::make_unique<EntitySchema<T>>();
+        schema->name = name;
+        schema->spawn = std::move(spawn);
+        auto& result = *schema;
+        auto found = table.entityTypeIndex.find(std::type_index(typeid(T)));
+        if (found != table.entityTypeIndex.end()) {
+            table.entityTypes[found->second] = std::move(schema);
+        } else {
+            table.entityTypeIndex.emplace(std::type_index(typeid(T)), static_cast<uint32_t>(table.entityTypes.size()));
+            table.entityTypes.push_back(std::move(schema));
+        }
+        return result;
+    }
+
+    template<typename T>
+    static TypedSchema<T>& AddComponent(Table& table, const std::string& name) {
+        static_assert(std::is_default_constructible_v<T>, "snapshot components are default-constructed on load");
+        auto schema = std::make_unique<ComponentSchema<T>>();
+        schema->name = name;
+        auto& result = *schema;
+        table.componentTypes.push_back(std::move(schema));
+        return result;
+    }
+
+    // Core Entity state, one per entity; changing it means bumping Version
+    struct EntityRecord {
+        uint32_t type;
+        uint32_t tag;
+        uint32_t index;
+        uint32_t generation;
+        Vector2 position;
+        Vector2 size;
+        Vector2 velocity;
+        Vector2 acceleration;
+        float rotation;
+        uint32_t collisionLayers;
+        Color color;
+    };
+    static_assert(sizeof(EntityRecord) == 60, "EntityRecord is part of the file format");
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t payloadSize; // Uncompressed
+        uint64_t storedSize;  // As written after the header
+    };
+    static_assert(sizeof(Header) == 32, "Header is part of the file format");
+
+    static bool IsLittleEndian() {
+        const uint16_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    // Magic, version and stored size; payload contents are checked on load
+    static bool ReadHeader(const std::vector<uint8_t>& bytes, Header& header) {
+        if (!IsLittleEndian() || bytes.size() < sizeof(Header)) return false;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (std::memcmp(header.magic, "GESN", 4) != 0 || header.version == 0 || header.version > Version) return false;
+        if (header.storedSize != bytes.size() - sizeof(Header)) return false;
+        return (header.flags & CompressedFlag) || header.payloadSize == header.storedSize;
+    }
+
+    class Writer {
+    public:
+        std::vector<uint8_t>& out;
+
+        void Put(const void* data, size_t size) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            out.insert(out.end(), bytes, bytes + size);
+        }
+        void U32(uint32_t value) { Put(&value, sizeof(value)); }
+        void String(const std::string& value) {
+            U32(static_cast<uint32_t>(value.size()));
+            Put(value.data(), value.size());
+        }
+        void Schemas(const std::vector<std::unique_ptr<Schema>>& schemas) {
+            U32(static_cast<uint32_t>(schemas.size()));
+            for (const auto& schema : schemas) {
+                String(schema->name);
+                U32(static_cast<uint32_t>(schema->fields.size()));
+                for (const auto& field : schema->fields) {
+                    String(field->name);
+                    U32(field->size);
+                    out.push_back(static_cast<uint8_t>(field->kind));
+                }
+            }
+        }
+    };
+
+    class Reader {
+    public:
+        const uint8_t* cursor;
+        const uint8_t* end;
+        bool ok = true;
+
+        const uint8_t* Take(size_t size) {
+            if (!ok || static_cast<size_t>(end - cursor) < size) {
+                ok = false;
+                return nullptr;
+            }
+            const uint8_t* at = cursor;
+            cursor += size;
+            return at;
+        }
+        uint32_t U32() {
+            uint32_t value = 0;
+            if (const uint8_t* at = Take(sizeof(value))) std::memcpy(&value, at, sizeof(value));
+            return value;
+        }
+        uint8_t U8() {
+            const uint8_t* at = Take(1);
+            return at ? *at : 0;
+        }
+        std::string String() {
+            uint32_t size = U32();
+            const uint8_t* at = Take(size);
+            return at ? std::string(reinterpret_cast<const char*>(at), size) : std::string();
+        }
+        // Record counts are checked against the bytes left before anything
+        // is sized from them
+        bool Fits(uint64_t count, uint64_t stride) {
+            if (ok && stride != 0 && count > static_cast<uint64_t>(end - cursor) / stride) ok = false;
+            return ok;
+        }
+    };
+
+    // How to copy one file record into a registered type; unknown types and
+    // fields are skipped using the sizes stored in the file
+    struct Plan {
+        const Schema* schema = nullptr;
+        uint32_t recordSize = 0;
+        struct Copy {
+            uint32_t offset;
+            const FieldAccess* field;
+        };
+        std::vector<Copy> copies;
+        bool hasRefs = false;
+    };
+
+    static std::vector<Plan> ReadPlans(Reader& reader, const std::vector<std::unique_ptr<Schema>>& registered) {
+        uint32_t count = reader.U32();
+        if (!reader.Fits(count, 8)) return {};
+        std::vector<Plan> plans(count);
+        for (Plan& plan : plans) {
+            std::string name = reader.String();
+            for (const auto& schema : registered) {
+                if (schema->name == name) plan.schema = schema.get();
+            }
+            uint32_t fieldCount = reader.U32();
+            if (!reader.Fits(fieldCount, 9)) return {};
+            for (uint32_t f = 0; f < fieldCount; f++) {
+                std::string fieldName = reader.String();
+                uint32_t size = reader.U32();
+                FieldKind kind = static_cast<FieldKind>(reader.U8());
+                if (plan.schema) {
+                    for (const auto& field : plan.schema->fields) {
+                        if (field->name == fieldName && field->size == size && field->kind == kind) {
+                            plan.copies.push_back(Plan::Copy{plan.recordSize, field.get()});
+                            plan.hasRefs |= kind == FieldKind::EntityRef;
+                        }
+                    }
+                }
+                if (size > UINT32_MAX - plan.recordSize) reader.ok = false;
+                plan.recordSize += size;
+            }
+        }
+        return reader.ok ? plans : std::vector<Plan>{};
+    }
+
+    // Old EntityId -> new EntityId for the loaded entities; anything else
+    // (including ids of entities that were not saved) becomes invalid.
+    // Saved ids are registry slots, so they are normally dense enough for
+    // a flat table; a sparse set falls back to a hash map.
+    class Remap {
+    private:
+        struct Entry {
+            uint32_t oldGeneration = 0;
+            EntityId id;
+        };
+        std::vector<Entry> dense;
+        std::unordered_map<uint32_t, Entry> sparse;
+        bool useDense = true;
+
+    public:
+        void Reserve(uint32_t maxIndex, size_t count) {
+            useDense = maxIndex <= count * 2 + 1024;
+            if (useDense) dense.resize(size_t{maxIndex} + 1);
+            else sparse.reserve(count);
+        }
+        void Add(uint32_t oldIndex, uint32_t oldGeneration, EntityId id) {
+            if (useDense) dense[oldIndex] = Entry{oldGeneration, id};
+            else sparse[oldIndex] = Entry{oldGeneration, id};
+        }
+        EntityId operator()(EntityId old) const {
+            const Entry* entry = nullptr;
+            if (useDense) {
+                if (old.index < dense.size()) entry = &dense[old.index];
+            } else {
+                auto it = sparse.find(old.index);
+                if (it != sparse.end()) entry = &it->second;
+            }
+            if (!entry || entry->oldGeneration != old.generation) return EntityId{};
+            return entry->id;
+        }
+    };
+
+    static void Apply(const Plan& plan, void* object, const uint8_t* record, const Remap& remap) {
+        for (const auto& copy : plan.copies) {
+            copy.field->Write(object, record + copy.offset);
+            if (copy.field->kind == FieldKind::EntityRef) {
+                EntityId id;
+                copy.field->Read(object, reinterpret_cast<uint8_t*>(&id));
+                id = remap(id);
+                copy.field->Write(object, reinterpret_cast<const uint8_t*>(&id));
+            }
+        }
+    }
+
+public:
+    // Registers an entity subclass. spawn creates a default instance in a
+    // scene (Scene::Spawn<T>() unless given); saved fields then overwrite it.
+    template<typename T>
+    static TypedSchema<T>& RegisterEntity(const std::string& name, std::function<T*(Scene&)> spawn = nullptr) {
+        if (!spawn) {
+            if constexpr (std::is_default_constructible_v<T>) {
+                spawn = [](Scene& scene) { return scene.Spawn<T>(); };
+            } else {
+                assert(false && "RegisterEntity needs a spawn function for types without a default constructor");
+            }
+        }
+        return AddEntity<T>(Get(), name, std::move(spawn));
+    }
 
-// Time management
-class DeltaTime {
-private:
-    static float deltaTime;
-    static std::chrono::steady_clock::time_point lastTime;
+    template<typename T>
+    static TypedSchema<T>& RegisterComponent(const std::string& name) {
+        ComponentTypes::Alias(name, ComponentTypes::Id<T>());
+        return AddComponent<T>(Get(), name);
+    }
 
-public:
-    static void Update() {
-        auto currentTime = std::chrono::steady_clock::now();
-        deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
-        lastTime = currentTime;
+    // fn(entity slot, record, size) for every component of every registered
+    // type, in pool order, with its fields packed as in a snapshot
+    template<typename Fn>
+    static void ForEachComponentRecord(Registry& registry, Fn&& fn) {
+        std::vector<uint8_t> record;
+        for (const auto& schema : Get().componentTypes) {
+            record.resize(schema->recordSize);
+            schema->ForEach(registry, [&](uint32_t slot, const void* component) {
+                uint32_t offset = 0;
+                for (const auto& field : schema->fields) {
+                    field->Read(component, record.data() + offset);
+                    offset += field->size;
+                }
+                fn(slot, record.data(), record.size());
+            });
+        }
     }
 
-    static float Get() { return deltaTime; }
-};
+    static bool IsRegistered(const Entity& entity) {
+        return Get().entityTypeIndex.count(std::type_index(typeid(entity))) != 0;
+    }
 
-float DeltaTime::deltaTime = 0.0f;
-std::chrono::steady_clock::time_point DeltaTime::lastTime = std::chrono::steady_clock::now();
+    // Serializes the scene's active entities and their registered
+    // components. Fails if an entity's type was never registered.
+    static bool SaveToMemory(Scene& scene, std::vector<uint8_t>& out, bool compress = false) {
+        std::vector<Entity*> entities;
+        entities.reserve(scene.GetEntities().size());
+        for (auto& entity : scene.GetEntities()) {
+            if (entity->active) entities.push_back(entity.get());
+        }
+        return SaveToMemory(scene, entities, out, compress);
+    }
 
-// Component system
-struct Component {
-    virtual ~Component() = default;
-};
+    // Serializes only the given entities of `scene`; references to entities
+    // outside the list load as invalid ids
+    static bool SaveToMemory(Scene& scene, const std::vector<Entity*>& entities, std::vector<uint8_t>& out,
+                             bool compress = false) {
+        if (!IsLittleEndian()) return false;
+        Table& table = Get();
+        Registry& registry = scene.GetRegistry();
 
-// Animation component
-struct AnimationComponent : public Component {
-    Texture2D spriteSheet;
-    Rectangle frameRect;
-    float frameTime = 0;
-    float frameDuration = 0.1f;
-    int currentFrame = 0;
-    int frameCount = 1;
-    bool loop = true;
-    bool playing = true;
+        std::vector<uint8_t> payload;
+        Writer writer{payload};
+        writer.Schemas(table.entityTypes);
+        writer.Schemas(table.componentTypes);
 
-    void Update() {
-        if (!playing) return;
-        
-        frameTime += DeltaTime::Get();
-        if (frameTime >= frameDuration) {
-            frameTime = 0;
-            currentFrame++;
-            if (currentFrame >= frameCount) {
-                if (loop) currentFrame = 0;
-                else {
-                    currentFrame = frameCount - 1;
-                    playing = false;
+        // Scene order is kept, so draw order survives a round trip
+        std::vector<uint32_t> types;
+        std::unordered_map<TagId, uint32_t> tagIndex;
+        std::vector<TagId> tags;
+        types.reserve(entities.size());
+        for (Entity* entity : entities) {
+            auto found = table.entityTypeIndex.find(std::type_index(typeid(*entity)));
+            if (found == table.entityTypeIndex.end()) return false;
+            types.push_back(found->second);
+            if (tagIndex.emplace(entity->GetTagId(), static_cast<uint32_t>(tags.size())).second) {
+                tags.push_back(entity->GetTagId());
+            }
+        }
+
+        writer.U32(static_cast<uint32_t>(tags.size()));
+        for (TagId tag : tags) writer.String(Tags::Name(tag));
+
+        writer.U32(static_cast<uint32_t>(types.size()));
+        size_t recordsAt = payload.size();
+        payload.resize(recordsAt + types.size() * sizeof(EntityRecord));
+        std::vector<uint8_t> record;
+        size_t n = 0;
+        for (Entity* entity : entities) {
+            EntityRecord r{types[n], tagIndex[entity->GetTagId()], entity->GetId().index,
+                           entity->GetId().generation, entity->position, entity->size, entity->velocity,
+                           entity->acceleration, entity->rotation, entity->collisionLayers, entity->color};
+            std::memcpy(payload.data() + recordsAt + n * sizeof(EntityRecord), &r, sizeof(r));
+            n++;
+        }
+        // Subclass fields, in entity order, each record sized by its type
+        n = 0;
+        for (Entity* entity : entities) {
+            const Schema& schema = *table.entityTypes[types[n++]];
+            record.resize(schema.recordSize);
+            void* object = schema.Object(*entity);
+            uint32_t offset = 0;
+            for (const auto& field : schema.fields) {
+                field->Read(object, record.data() + offset);
+                offset += field->size;
+            }
+            writer.Put(record.data(), record.size());
+        }
+
+        // Entity slot -> position in `entities`, built only if a whole pool
+        // is walked, since its size follows the scene rather than the list
+        std::vector<uint32_t> ordinalBySlot;
+        for (const auto& schema : table.componentTypes) {
+            size_t countAt = payload.size();
+            writer.U32(0);
+            uint32_t count = 0;
+            record.resize(schema->recordSize);
+            auto put = [&](uint32_t ordinal, const void* component) {
+                writer.U32(ordinal);
+                uint32_t offset = 0;
+                for (const auto& field : schema->fields) {
+                    field->Read(component, record.data() + offset);
+                    offset += field->size;
+                }
+                writer.Put(record.data(), record.size());
+                count++;
+            };
+            // Small subsets (e.g. one world chunk) look components up per
+            // entity instead of filtering the whole pool
+            if (entities.size() < schema->Count(registry)) {
+                for (size_t i = 0; i < entities.size(); i++) {
+                    const void* component = schema->Find(registry, entities[i]->GetId().index);
+                    if (component) put(static_cast<uint32_t>(i), component);
+                }
+            } else {
+                if (ordinalBySlot.empty()) {
+                    for (size_t i = 0; i < entities.size(); i++) {
+                        uint32_t slot = entities[i]->GetId().index;
+                        if (slot >= ordinalBySlot.size()) ordinalBySlot.resize(slot + 1, UINT32_MAX);
+                        ordinalBySlot[slot] = static_cast<uint32_t>(i);
+                    }
                 }
+                schema->ForEach(registry, [&](uint32_t slot, const void* component) {
+                    if (slot >= ordinalBySlot.size() || ordinalBySlot[slot] == UINT32_MAX) return;
+                    put(ordinalBySlot[slot], component);
+                });
             }
-            frameRect.x = frameRect.width * currentFrame;
+            std::memcpy(payload.data() + countAt, &count, sizeof(count));
+        }
+
+        Header header{{'G', 'E', 'S', 'N'}, Version, compress ? CompressedFlag : 0, 0, payload.size(), 0};
+        out.resize(sizeof(Header));
+        if (compress) {
+            Lz::Compress(payload.data(), payload.size(), out);
+        } else {
+            out.insert(out.end(), payload.begin(), payload.end());
         }
+        header.storedSize = out.size() - sizeof(Header);
+        std::memcpy(out.data(), &header, sizeof(header));
+        return true;
     }
-};
 
-// Particle component
-struct ParticleEmitter : public Component {
-    struct Particle {
-        Vector2 position;
-        Vector2 velocity;
-        float lifetime;
-        float maxLifetime;
-        Color color;
-        float size;
-        bool active = true;
-    };
+    // Adds the snapshot's entities to `scene` (use Scene::Clear first to
+    // replace its contents). The whole input is validated before the scene
+    // is touched, so a truncated or corrupt snapshot leaves it unchanged.
+    static bool LoadFromMemory(const uint8_t* data, size_t size, Scene& scene) {
+        if (!IsLittleEndian() || size < sizeof(Header)) return false;
+        Header header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, "GESN", 4) != 0 || header.version == 0 || header.version > Version) return false;
+        if (header.storedSize != size - sizeof(Header)) return false;
 
-    std::vector<Particle> particles;
-    Vector2 offset{0, 0};
-    float emitRate = 10;
-    float emitTimer = 0;
-    float particleLifetime = 1.0f;
-    Color particleColor = WHITE;
-    float particleSpeed = 100.0f;
-    bool emitting = true;
+        const uint8_t* payload = data + sizeof(Header);
+        std::vector<uint8_t> decompressed;
+        if (header.flags & CompressedFlag) {
+            // LZ output never exceeds 255x its input
+            if (header.payloadSize > header.storedSize * 255 + 16) return false;
+            decompressed.resize(header.payloadSize);
+            if (!Lz::Decompress(payload, header.storedSize, decompressed.data(), decompressed.size())) return false;
+            payload = decompressed.data();
+        } else if (header.payloadSize != header.storedSize) {
+            return false;
+        }
 
-    void Update(const Vector2& emitterPos) {
-        // Update existing particles
-        for (auto& p : particles) {
-            if (!p.active) continue;
+        Table& table = Get();
+        Reader reader{payload, payload + header.payloadSize};
+        std::vector<Plan> entityPlans = ReadPlans(reader, table.entityTypes);
+        std::vector<Plan> componentPlans = ReadPlans(reader, table.componentTypes);
 
-            p.lifetime -= DeltaTime::Get();
-            if (p.lifetime <= 0) {
-                p.active = false;
-                continue;
+        uint32_t tagCount = reader.U32();
+        if (!reader.Fits(tagCount, 4)) return false;
+        std::vector<std::string> tags(tagCount);
+        for (auto& tag : tags) tag = reader.String();
+
+        uint32_t entityCount = reader.U32();
+        if (!reader.Fits(entityCount, sizeof(EntityRecord))) return false;
+        const uint8_t* records = reader.Take(size_t{entityCount} * sizeof(EntityRecord));
+        std::vector<const uint8_t*> extras(entityCount);
+        uint32_t maxIndex = 0;
+        for (uint32_t i = 0; i < entityCount && reader.ok; i++) {
+            EntityRecord r;
+            std::memcpy(&r, records + i * sizeof(EntityRecord), sizeof(r));
+            if (r.type >= entityPlans.size() || !entityPlans[r.type].schema || r.tag >= tags.size()) return false;
+            extras[i] = reader.Take(entityPlans[r.type].recordSize);
+            maxIndex = std::max(maxIndex, r.index);
+        }
+
+        struct ComponentBlock {
+            const Plan* plan;
+            uint32_t count;
+            const uint8_t* records;
+        };
+        std::vector<ComponentBlock> blocks;
+        for (const Plan& plan : componentPlans) {
+            uint32_t count = reader.U32();
+            const uint64_t stride = uint64_t{plan.recordSize} + 4;
+            if (!reader.Fits(count, stride)) return false;
+            const uint8_t* at = reader.Take(count * stride);
+            for (uint32_t i = 0; i < count && at; i++) {
+                uint32_t owner;
+                std::memcpy(&owner, at + i * stride, sizeof(owner));
+                if (owner >= entityCount) return false;
             }
+            if (plan.schema) blocks.push_back(ComponentBlock{&plan, count, at});
+        }
+        if (!reader.ok) return false;
 
-            float lifePercent = p.lifetime / p.maxLifetime;
-            p.color.a = static_cast<unsigned char>(255 * lifePercent);
-            
-            p.position.x += p.velocity.x * DeltaTime::Get();
-            p.position.y += p.velocity.y * DeltaTime::Get();
-            
-            // Add gravity effect
-            p.velocity.y += 200.0f * DeltaTime::Get();
+        // Everything checks out: create the entities, then fill in fields
+        // once every id is known so references can be remapped
+        std::vector<Entity*> created(entityCount);
+        Remap remap;
+        remap.Reserve(maxIndex, entityCount);
+        for (uint32_t i = 0; i < entityCount; i++) {
+            EntityRecord r;
+            std::memcpy(&r, records + i * sizeof(EntityRecord), sizeof(r));
+            Entity* entity = entityPlans[r.type].schema->Spawn(scene);
+            entity->position = r.position;
+            entity->size = r.size;
+            entity->velocity = r.velocity;
+            entity->acceleration = r.acceleration;
+            entity->rotation = r.rotation;
+            entity->collisionLayers = r.collisionLayers;
+            entity->color = r.color;
+            if (entity->tag != tags[r.tag]) scene.SetTag(*entity, tags[r.tag]);
+            remap.Add(r.index, r.generation, entity->GetId());
+            created[i] = entity;
+        }
+        for (uint32_t i = 0; i < entityCount; i++) {
+            EntityRecord r;
+            std::memcpy(&r, records + i * sizeof(EntityRecord), sizeof(r));
+            const Plan& plan = entityPlans[r.type];
+            Apply(plan, plan.schema->Object(*created[i]), extras[i], remap);
+            created[i]->SavePreviousState();
         }
 
-        // Emit new particles
-        if (emitting) {
-            emitTimer += DeltaTime::Get();
-            if (emitTimer >= 1.0f / emitRate) {
-                EmitParticle(emitterPos);
-                emitTimer = 0;
+        Registry& registry = scene.GetRegistry();
+        for (const ComponentBlock& block : blocks) {
+            const size_t stride = size_t{block.plan->recordSize} + 4;
+            for (uint32_t i = 0; i < block.count; i++) {
+                const uint8_t* at = block.records + i * stride;
+                uint32_t owner;
+                std::memcpy(&owner, at, sizeof(owner));
+                void* component = block.plan->schema->Add(registry, created[owner]->GetId());
+                Apply(*block.plan, component, at + 4, remap);
             }
         }
+        return true;
+    }
 
-        // Remove dead particles
-        particles.erase(
-            std::remove_if(particles.begin(), particles.end(),
-                [](const Particle& p) { return !p.active; }),
-            particles.end());
+    // Convert a snapshot between raw and LZ-compressed form in place, so
+    // the (de)compression can run off the main thread, which then only
+    // builds and spawns raw snapshots. Already in the requested form is a
+    // no-op; false (bytes untouched) if `bytes` is not a valid snapshot.
+    static bool Compress(std::vector<uint8_t>& bytes) {
+        Header header;
+        if (!ReadHeader(bytes, header)) return false;
+        if (header.flags & CompressedFlag) return true;
+        std::vector<uint8_t> out(sizeof(Header));
+        Lz::Compress(bytes.data() + sizeof(Header), header.payloadSize, out);
+        header.flags |= CompressedFlag;
+        header.storedSize = out.size() - sizeof(Header);
+        std::memcpy(out.data(), &header, sizeof(header));
+        bytes = std::move(out);
+        return true;
     }
 
-    void EmitParticle(const Vector2& emitterPos) {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        std::uniform_real_distribution<float> angleDist(-PI, PI);
-        std::uniform_real_distribution<float> speedDist(0.5f, 1.0f);
-        std::uniform_real_distribution<float> sizeDist(2.0f, 5.0f);
+    static bool Decompress(std::vector<uint8_t>& bytes) {
+        Header header;
+        if (!ReadHeader(bytes, header)) return false;
+        if (!(header.flags & CompressedFlag)) return true;
+        if (header.payloadSize > header.storedSize * 255 + 16) return false;
+        std::vector<uint8_t> out(sizeof(Header) + header.payloadSize);
+        if (!Lz::Decompress(bytes.data() + sizeof(Header), header.storedSize, out.data() + sizeof(Header),
+                            header.payloadSize)) {
+            return false;
+        }
+        header.flags &= ~CompressedFlag;
+        header.storedSize = header.payloadSize;
+        std::memcpy(out.data(), &header, sizeof(header));
+        bytes = std::move(out);
+        return true;
+    }
 
-        Particle p;
-        p.position = Vector2{emitterPos.x + offset.x, emitterPos.y + offset.y};
-        
-        float angle = angleDist(gen);
-        float speed = particleSpeed * speedDist(gen);
-        p.velocity = Vector2{cos(angle) * speed, sin(angle) * speed};
-        
-        p.lifetime = p.maxLifetime = particleLifetime;
-        p.color = particleColor;
-        p.size = sizeDist(gen);
-        
-        particles.push_back(p);
+    static bool Save(Scene& scene, const std::string& path, bool compress = false) {
+        std::vector<uint8_t> bytes;
+        if (!SaveToMemory(scene, bytes, compress)) return false;
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return file.good();
     }
 
-    void Draw() {
-        for (const auto& p : particles) {
-            if (p.active) {
-                DrawCircle(
-                    static_cast<int>(p.position.x),
-                    static_cast<int>(p.position.y),
-                    p.size,
-                    p.color
-                );
-            }
-        }
+    // Convenience wrapper over LoadFromMemory. The file is mapped rather
+    // than read, which only saves the copy into a buffer for uncompressed
+    // snapshots; entities are still spawned and their fields copied.
+    static bool Load(const std::string& path, Scene& scene) {
+        MappedFile file;
+        if (!file.Open(path)) return false;
+        return LoadFromMemory(file.Data(), file.Size(), scene);
     }
 };
 
-class Entity {
-private:
-    std::unordered_map<std::string, std::shared_ptr<Component>> components;
+inline uint64_t Scene::StateHash() {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i += sizeof(uint32_t)) {
+            uint32_t word = 0;
+            std::memcpy(&word, bytes + i, std::min(sizeof(word), size - i));
+            hash = (hash ^ word) * 0x100000001b3ull;
+        }
+    };
+    for (const auto& entity : entities) {
+        if (!entity->active) continue;
+        const Entity& e = *entity;
+        const EntityId id = e.GetId();
+        mix(&id, sizeof(id));
+        mix(&e.position, sizeof(e.position));
+        mix(&e.velocity, sizeof(e.velocity));
+        mix(&e.rotation, sizeof(e.rotation));
+        mix(&e.size, sizeof(e.size));
+        mix(&e.color, sizeof(e.color));
+        mix(&e.collisionLayers, sizeof(e.collisionLayers));
+    }
+    const uint64_t particleCount = particles.Count();
+    mix(&particleCount, sizeof(particleCount));
+    for (size_t i = 0; i < particleCount; i++) {
+        const ParticleSystem::Particle particle = particles.GetParticle(i);
+        mix(&particle, sizeof(particle));
+    }
+    Snapshot::ForEachComponentRecord(registry, [&](uint32_t slot, const uint8_t* record, size_t size) {
+        mix(&slot, sizeof(slot));
+        mix(record, size);
+    });
+    return hash;
+}
 
+// Splits the world into square chunks and keeps only the area around the
+// focus points live. Entities in chunks within the active radius (in
+// chunks, measured to the nearest focus) update normally; those within the
+// resident radius stay in the scene asleep; the rest are serialized with
+// Snapshot and removed from the scene, and a background thread compresses
+// them and writes them to `directory/chunk_X_Y.bin` (or keeps them in
+// memory when no directory is given). When a focus comes within the
+// resident radius again, that thread reads and decompresses the chunk and
+// the main thread respawns it. The main thread only gathers and spawns
+// entities, so memory and per-tick cost follow the area around the focus
+// points rather than the size of the world.
+//
+// Chunks are reclassified when a focus crosses a chunk border or on
+// Refresh, so an entity that wanders out of the active area keeps running
+// until then. Only entity types registered with Snapshot are unloaded;
+// others just sleep. Unloaded entities get new ids when they come back, and
+// references between different chunks do not survive an unload. Main
+// thread only; call Update once per frame outside Scene::Update.
+class WorldStreamer {
 public:
-    Vector2 position{0, 0};
-    Vector2 size{32, 32};
-    Color color{WHITE};
-    bool active{true};
-    float rotation{0.0f};
-    Vector2 velocity{0, 0};
-    Vector2 acceleration{0, 0};
-    std::string tag;
-    
-    template<typename T>
-    void AddComponent(const std::string& name, std::shared_ptr<T> component) {
-        components[name] = component;
+    struct Stats {
+        size_t awakeEntities = 0;    // As of the last reclassification
+        size_t sleepingEntities = 0;
+        size_t storedChunks = 0;
+        size_t chunkLoads = 0;
+        size_t chunkUnloads = 0;
+        size_t failedLoads = 0;      // Chunks whose entities were lost
+    };
+
+private:
+    using ChunkKey = uint64_t;
+
+    struct StoredChunk {
+        bool writing = true; // Loads wait until the write job has finished
+        bool loading = false;
+        // The compressed snapshot when there is no directory, or after a
+        // failed write
+        std::vector<uint8_t> bytes;
+    };
+
+    // Writes take a raw snapshot and compress it; reads return a raw one.
+    // An empty path means the chunk lives in memory, in `bytes`.
+    struct Request {
+        bool write;
+        ChunkKey key;
+        std::string path;
+        std::vector<uint8_t> bytes;
+        bool compress;
+    };
+
+    struct Result {
+        bool write;
+        ChunkKey key;
+        bool ok;
+        // Reads: the raw snapshot. Writes: the stored form when it stays in
+        // memory (no directory, or the file write failed), else empty
+        std::vector<uint8_t> bytes;
+    };
+
+    Scene& scene;
+    std::string directory;
+    float chunkSize;
+    int activeRadius = 1;
+    int residentRadius = 2;
+    int hysteresis = 1;
+    bool compress = true;
+
+    std::vector<Vector2> focus;
+    std::vector<std::pair<int32_t, int32_t>> focusChunks;
+    std::vector<std::pair<int32_t, int32_t>> classifiedChunks;
+    bool dirty = true;
+    std::unordered_map<ChunkKey, StoredChunk> stored;
+    Stats stats;
+    size_t inFlight = 0;
+
+    // Shared with the I/O thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<Request> requests;
+    std::deque<Result> results;
+    bool stop = false;
+    std::thread io;
+
+    static ChunkKey Key(int32_t x, int32_t y) {
+        return (uint64_t{static_cast<uint32_t>(x)} << 32) | static_cast<uint32_t>(y);
     }
+    static int32_t KeyX(ChunkKey key) { return static_cast<int32_t>(static_cast<uint32_t>(key >> 32)); }
+    static int32_t KeyY(ChunkKey key) { return static_cast<int32_t>(static_cast<uint32_t>(key)); }
 
-    template<typename T>
-    std::shared_ptr<T> GetComponent(const std::string& name) {
-        auto it = components.find(name);
-        if (it != components.end()) {
-            return std::static_pointer_cast<T>(it->second);
+    std::pair<int32_t, int32_t> ChunkOf(Vector2 position) const {
+        return {static_cast<int32_t>(std::floor(position.x / chunkSize)),
+                static_cast<int32_t>(std::floor(position.y / chunkSize))};
+    }
+
+    // Chebyshev distance in chunks to the nearest focus
+    int Distance(int32_t x, int32_t y) const {
+        int best = INT_MAX;
+        for (const auto& f : focusChunks) {
+            int64_t d = std::max(std::llabs(int64_t{x} - f.first), std::llabs(int64_t{y} - f.second));
+            best = static_cast<int>(std::min<int64_t>(best, d));
+        }
+        return best;
+    }
+
+    std::string PathOf(ChunkKey key) const {
+        return directory + "/chunk_" + std::to_string(KeyX(key)) + "_" + std::to_string(KeyY(key)) + ".bin";
+    }
+
+    static bool ReadFile(const std::string& path, std::vector<uint8_t>& bytes) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), bytes.size()));
+    }
+
+    void IoLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stop || !requests.empty(); });
+            if (stop) return;
+            Request request = std::move(requests.front());
+            requests.pop_front();
+            lock.unlock();
+            Result result{request.write, request.key, false, {}};
+            if (request.write) {
+                if (request.compress) Snapshot::Compress(request.bytes);
+                if (request.path.empty()) {
+                    result.ok = true;
+                } else {
+                    std::ofstream file(request.path, std::ios::binary);
+                    file.write(reinterpret_cast<const char*>(request.bytes.data()),
+                               static_cast<std::streamsize>(request.bytes.size()));
+                    result.ok = file.good();
+                }
+                if (request.path.empty() || !result.ok) result.bytes = std::move(request.bytes);
+            } else {
+                if (request.path.empty()) {
+                    result.bytes = std::move(request.bytes);
+                    result.ok = true;
+                } else {
+                    result.ok = ReadFile(request.path, result.bytes);
+                    std::error_code ignored;
+                    std::filesystem::remove(request.path, ignored);
+                }
+                result.ok = result.ok && Snapshot::Decompress(result.bytes);
+            }
+            lock.lock();
+            results.push_back(std::move(result));
+            done.notify_all();
         }
-        return nullptr;
     }
-    
-    virtual void Update() {
-        // Apply acceleration
-        velocity.x += acceleration.x * DeltaTime::Get();
-        velocity.y += acceleration.y * DeltaTime::Get();
-        
-        // Apply velocity
-        position.x += velocity.x * DeltaTime::Get();
-        position.y += velocity.y * DeltaTime::Get();
 
-        // Update components
-        for (auto& [name, component] : components) {
-            if (auto anim = std::dynamic_pointer_cast<AnimationComponent>(component)) {
-                anim->Update();
+    void Queue(Request request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(std::move(request));
+        }
+        inFlight++;
+        wake.notify_one();
+    }
+
+    void Spawn(ChunkKey key, const std::vector<uint8_t>& bytes) {
+        auto& entities = scene.GetEntities();
+        size_t before = entities.size();
+        if (!Snapshot::LoadFromMemory(bytes.data(), bytes.size(), scene)) {
+            stats.failedLoads++;
+            return;
+        }
+        bool asleep = Distance(KeyX(key), KeyY(key)) > activeRadius;
+        for (size_t i = before; i < entities.size(); i++) entities[i]->sleeping = asleep;
+        stats.chunkLoads++;
+    }
+
+    void ApplyResults() {
+        while (true) {
+            Result result;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (results.empty()) return;
+                result = std::move(results.front());
+                results.pop_front();
+            }
+            inFlight--;
+            auto it = stored.find(result.key);
+            if (it == stored.end()) continue;
+            if (result.write) {
+                // A failed write keeps the data in memory rather than lose it
+                it->second.writing = false;
+                it->second.bytes = std::move(result.bytes);
+                // A focus may have come back while it was being written
+                if (Distance(KeyX(result.key), KeyY(result.key)) <= residentRadius) dirty = true;
+                continue;
             }
-            if (auto emitter = std::dynamic_pointer_cast<ParticleEmitter>(component)) {
-                emitter->Update(position);
+            // The focus may have moved on while the chunk was in flight
+            dirty = true;
+            if (result.ok) {
+                Spawn(result.key, result.bytes);
+            } else {
+                stats.failedLoads++;
             }
+            stored.erase(it);
         }
     }
 
-    virtual void Draw() {
-        // Draw particle effects first
-        if (auto emitter = GetComponent<ParticleEmitter>("particles")) {
-            emitter->Draw();
+    void Unload(ChunkKey key, const std::vector<Entity*>& list) {
+        // A chunk already stored is not reopened; late arrivals wait in the
+        // scene, asleep, until it comes back
+        std::vector<uint8_t> bytes;
+        if (stored.count(key) || !Snapshot::SaveToMemory(scene, list, bytes)) {
+            for (Entity* entity : list) entity->sleeping = true;
+            stats.sleepingEntities += list.size();
+            return;
         }
+        for (Entity* entity : list) scene.Destroy(*entity);
+        stored[key] = StoredChunk{};
+        Queue(Request{true, key, directory.empty() ? std::string() : PathOf(key), std::move(bytes), compress});
+        stats.chunkUnloads++;
+    }
 
-        // Draw sprite or animation
-        if (auto anim = GetComponent<AnimationComponent>("animation")) {
-            DrawTexturePro(
-                anim->spriteSheet,
-                anim->frameRect,
-                Rectangle{position.x, position.y, size.x, size.y},
-                Vector2{size.x/2, size.y/2},
-                rotation,
-                color
-            );
+    void Load(ChunkKey key, StoredChunk& chunk) {
+        if (chunk.writing || chunk.loading) return;
+        chunk.loading = true;
+        if (!chunk.bytes.empty()) {
+            Queue(Request{false, key, std::string(), std::move(chunk.bytes), false});
         } else {
-            DrawRectanglePro(
-                Rectangle{position.x, position.y, size.x, size.y},
-                Vector2{size.x/2, size.y/2},
-                rotation,
-                color
-            );
+            Queue(Request{false, key, PathOf(key), {}, false});
         }
     }
-    
-    bool CheckCollision(const Entity& other) {
-        return CheckCollisionRecs(GetBounds(), other.GetBounds());
+
+    void Reclassify() {
+        PROFILE_ZONE("WorldStreamer::Reclassify");
+        stats.awakeEntities = 0;
+        stats.sleepingEntities = 0;
+        std::unordered_map<ChunkKey, std::vector<Entity*>> outgoing;
+        for (auto& entity : scene.GetEntities()) {
+            if (!entity->active) continue;
+            auto chunk = ChunkOf(entity->position);
+            int distance = Distance(chunk.first, chunk.second);
+            if (distance <= activeRadius) {
+                entity->sleeping = false;
+                stats.awakeEntities++;
+            } else if (distance > residentRadius + hysteresis && Snapshot::IsRegistered(*entity)) {
+                outgoing[Key(chunk.first, chunk.second)].push_back(entity.get());
+            } else {
+                entity->sleeping = true;
+                stats.sleepingEntities++;
+            }
+        }
+        for (const auto& [key, list] : outgoing) Unload(key, list);
+
+        // Only chunks near a focus are looked up, not every stored one
+        for (const auto& f : focusChunks) {
+            for (int64_t y = int64_t{f.second} - residentRadius; y <= int64_t{f.second} + residentRadius; y++) {
+                for (int64_t x = int64_t{f.first} - residentRadius; x <= int64_t{f.first} + residentRadius; x++) {
+                    auto it = stored.find(Key(static_cast<int32_t>(x), static_cast<int32_t>(y)));
+                    if (it != stored.end()) Load(it->first, it->second);
+                }
+            }
+        }
+        classifiedChunks = focusChunks;
+        dirty = false;
     }
 
-    Rectangle GetBounds() const {
-        return Rectangle{
-            position.x - size.x/2,
-            position.y - size.y/2,
-            size.x,
-            size.y
-        };
+public:
+    WorldStreamer(Scene& target, float chunkWorldSize, std::string chunkDirectory = {})
+        : scene(target), directory(std::move(chunkDirectory)), chunkSize(std::max(chunkWorldSize, 1.0f)) {
+        if (!directory.empty()) {
+            std::error_code ignored;
+            std::filesystem::create_directories(directory, ignored);
+        }
+        io = std::thread([this] { IoLoop(); });
     }
-};
 
-class Scene {
-private:
-    std::vector<std::shared_ptr<Entity>> entities;
-    std::unordered_map<std::string, std::vector<std::shared_ptr<Entity>>> taggedEntities;
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
 
-public:
-    void AddEntity(std::shared_ptr<Entity> entity) {
-        entities.push_back(entity);
-        if (!entity->tag.empty()) {
-            taggedEntities[entity->tag].push_back(entity);
+    // Stored chunks are discarded, including their files: the directory is
+    // a cache for this streamer, not a save game
+    ~WorldStreamer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
         }
+        wake.notify_all();
+        if (io.joinable()) io.join();
+        if (directory.empty()) return;
+        std::error_code ignored;
+        for (const auto& entry : stored) std::filesystem::remove(PathOf(entry.first), ignored);
     }
 
-    std::vector<std::shared_ptr<Entity>> GetEntitiesByTag(const std::string& tag) {
-        return taggedEntities[tag];
+    // Chunks within `active` of a focus update; within `resident` they
+    // sleep. A chunk unloads once it is more than resident + hysteresis
+    // away, so a focus pacing along a border doesn't thrash.
+    void SetRadius(int active, int resident, int hysteresisChunks = 1) {
+        activeRadius = std::max(active, 0);
+        residentRadius = std::max(resident, activeRadius);
+        hysteresis = std::max(hysteresisChunks, 0);
+        dirty = true;
     }
 
+    void SetCompression(bool enabled) { compress = enabled; }
+
+    void SetFocus(Vector2 point) { focus.assign(1, point); }
+    void SetFocus(const std::vector<Vector2>& points) { focus = points; }
+
+    // Reclassify on the next Update even if no focus changed chunk
+    void Refresh() { dirty = true; }
+
+    // Spawns chunks whose reads have finished and, when a focus has moved
+    // to another chunk, sleeps, wakes, unloads and requests chunks. Does
+    // nothing without a focus point.
     void Update() {
-        DeltaTime::Update();
-        for(auto it = entities.begin(); it != entities.end();) {
-            if((*it)->active) {
-                (*it)->Update();
-                ++it;
-            } else {
-                if (!(*it)->tag.empty()) {
-                    auto& taggedList = taggedEntities[(*it)->tag];
-                    auto taggedIt = std::find(taggedList.begin(), taggedList.end(), *it);
-                    if (taggedIt != taggedList.end()) {
-                        taggedList.erase(taggedIt);
-                    }
+        PROFILE_ZONE("WorldStreamer::Update");
+        ApplyResults();
+        if (focus.empty()) return;
+        focusChunks.clear();
+        for (Vector2 point : focus) focusChunks.push_back(ChunkOf(point));
+        if (dirty || focusChunks != classifiedChunks) Reclassify();
+    }
+
+    // Blocks until the streamer has settled around the current focus: every
+    // read and write done, and every chunk within reach spawned, e.g. behind
+    // a loading screen after a teleport
+    void WaitIdle() {
+        while (true) {
+            while (inFlight > 0) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    done.wait(lock, [&] { return !results.empty(); });
                 }
-                it = entities.erase(it);
+                ApplyResults();
             }
+            if (!dirty || focus.empty()) return;
+            Update();
         }
     }
 
-    void Draw() {
-        for(auto& entity : entities) {
-            if(entity->active) {
-                entity->Draw();
-            }
-        }
+    bool IsStored(Vector2 position) const {
+        auto chunk = ChunkOf(position);
+        return stored.count(Key(chunk.first, chunk.second)) != 0;
     }
 
-    std::vector<std::shared_ptr<Entity>>& GetEntities() {
-        return entities;
+    size_t PendingCount() const { return inFlight; }
+
+    Stats GetStats() const {
+        Stats result = stats;
+        result.storedChunks = stored.size();
+        return result;
     }
 };
 
+enum class EngineMode {
+    Windowed,
+    Headless // No window or GL context; draws go to the null renderer
+};
+
 class GameEngine {
 private:
     int screenWidth;
@@ -302,51 +5665,299 @@ private:
     std::string title;
     Scene currentScene;
     bool debugMode = false;
+    EngineMode mode;
+    bool quitRequested = false;
+    FrameArena frameArena;
+    uint64_t frameAllocationMark = 0;
+    uint64_t lastFrameAllocations = 0;
+
+    // Fixed-step simulation: 0 tick rate means one variable step per frame
+    float tickRate = 60.0f;
+    int maxSubsteps = 5;
+    float accumulator = 0.0f;
+    double uploadBudgetMs = 2.0;
+
+    float TickLength() const {
+        return tickRate > 0.0f ? 1.0f / tickRate : 1.0f / 60.0f;
+    }
+
+    InputRecording recording;
+
+    // One simulation step; dt <= 0 means a variable step measured from
+    // the clock
+    void Tick(float dt) {
+        Input::BeginTick();
+        if (dt > 0.0f) currentScene.Update(dt);
+        else currentScene.Update();
+        if (Input::IsRecording()) {
+            recording.ticks.push_back(InputRecording::TickRecord{DeltaTime::Get(), 0, currentScene.StateHash()});
+        }
+    }
+
+#ifndef GAME_ENGINE_HEADLESS
+    // Timeline of the previous frame: one row of bars per thread, stacked by
+    // zone depth, followed by the top-level system totals in milliseconds.
+    void DrawProfilerOverlay() {
+        uint64_t frameBegin = Profiler::LastFrameStart();
+        uint64_t frameEnd = Profiler::FrameStart();
+        if (frameEnd <= frameBegin) return;
+
+        std::vector<Profiler::Event> events;
+        Profiler::Collect(events, frameBegin);
+
+        const int left = 10;
+        const int top = 40;
+        const int width = screenWidth - 20;
+        const int barHeight = 12;
+        const int maxDepth = 4;
+        const double scale = static_cast<double>(width) / static_cast<double>(frameEnd - frameBegin);
+        static const Color palette[] = {SKYBLUE, ORANGE, LIME, PINK, GOLD, VIOLET};
+
+        uint32_t threads = 0;
+        std::vector<std::pair<const char*, uint64_t>> totals;
+        for (const auto& e : events) {
+            if (e.startNs < frameBegin || e.endNs > frameEnd) continue;
+            threads = std::max(threads, e.thread + 1);
+            if (e.depth <= 1) {
+                auto it = std::find_if(totals.begin(), totals.end(),
+                    [&](const auto& total) { return total.first == e.name; });
+                if (it == totals.end()) totals.emplace_back(e.name, e.endNs - e.startNs);
+                else it->second += e.endNs - e.startNs;
+            }
+            if (e.depth >= maxDepth) continue;
+            int x = left + static_cast<int>((e.startNs - frameBegin) * scale);
+            int w = std::max(1, static_cast<int>((e.endNs - e.startNs) * scale));
+            int y = top + static_cast<int>(e.thread * maxDepth + e.depth) * barHeight;
+            DrawRectangle(x, y, w, barHeight - 1, Fade(palette[e.depth % 6], 0.8f));
+            if (w > 40) DrawText(e.name, x + 2, y + 1, 10, BLACK);
+        }
+
+        int y = top + static_cast<int>(threads * maxDepth) * barHeight + 4;
+        for (const auto& total : totals) {
+            DrawText(TextFormat("%-24s %6.3f ms", total.first, total.second / 1e6), left, y, 10, RAYWHITE);
+            y += 12;
+        }
+    }
+#endif
 
 public:
-    GameEngine(int width, int height, const std::string& windowTitle) 
-        : screenWidth(width), screenHeight(height), title(windowTitle) {
-        InitWindow(screenWidth, screenHeight, title.c_str());
-        SetTargetFPS(60);
+    GameEngine(int width, int height, const std::string& windowTitle, EngineMode engineMode = EngineMode::Windowed)
+        : screenWidth(width), screenHeight(height), title(windowTitle), mode(engineMode) {
+        currentScene.SetFrameResource(&frameArena);
+        currentScene.SetViewportSize(static_cast<float>(width), static_cast<float>(height));
+#ifdef GAME_ENGINE_HEADLESS
+        mode = EngineMode::Headless;
+#else
+        if (mode == EngineMode::Windowed) {
+            InitWindow(screenWidth, screenHeight, title.c_str());
+            SetTargetFPS(60);
+            ResourceManager::SetNullRenderer(false);
+            return;
+        }
+#endif
+        currentScene.GetRenderBatch().SetNullRenderer(true);
+        ResourceManager::SetNullRenderer(true);
     }
 
     ~GameEngine() {
-        CloseWindow();
+#ifndef GAME_ENGINE_HEADLESS
+        if (mode == EngineMode::Windowed) {
+            currentScene.GetRenderBatch().Unload();
+            ResourceManager::Shutdown();
+            CloseWindow();
+        }
+#endif
     }
 
+    bool IsHeadless() const { return mode == EngineMode::Headless; }
+
     bool ShouldClose() {
-        return WindowShouldClose();
+#ifndef GAME_ENGINE_HEADLESS
+        if (mode == EngineMode::Windowed && WindowShouldClose()) return true;
+#endif
+        return quitRequested;
     }
 
+    void RequestQuit() { quitRequested = true; }
+
+    // Starts a frame. Textures finished loading in the background are
+    // uploaded first, within the upload budget.
     void Clear() {
+        Profiler::MarkFrame();
+        ResourceManager::Update(uploadBudgetMs);
+#ifndef GAME_ENGINE_HEADLESS
+        if (mode == EngineMode::Headless) return;
         BeginDrawing();
         ClearBackground(BLACK);
+#endif
     }
 
+    // Ends the frame: presents it in windowed mode, records the frame's heap
+    // allocation count and resets the frame arena.
     void Display() {
-        if (debugMode) {
-            DrawFPS(10, 10);
-            for (auto& entity : currentScene.GetEntities()) {
-                if (entity->active) {
-                    DrawRectangleLinesEx(entity->GetBounds(), 1, GREEN);
+#ifndef GAME_ENGINE_HEADLESS
+        if (mode == EngineMode::Windowed) {
+            if (debugMode) {
+                DrawFPS(10, 10);
+                if (currentScene.HasCamera()) BeginMode2D(currentScene.GetCamera());
+                for (auto& entity : currentScene.GetEntities()) {
+                    if (entity->active) {
+                        DrawRectangleLinesEx(entity->GetBounds(), 1, GREEN);
+                    }
                 }
+                if (currentScene.HasCamera()) EndMode2D();
+                DrawProfilerOverlay();
             }
+            EndDrawing();
         }
-        EndDrawing();
+#endif
+        uint64_t allocations = AllocationCounter::Get();
+        lastFrameAllocations = allocations - frameAllocationMark;
+        frameAllocationMark = allocations;
+        frameArena.Reset();
     }
 
+    // Debug mode also turns the profiler on so the overlay has data
     void ToggleDebugMode() {
         debugMode = !debugMode;
+        Profiler::SetEnabled(debugMode);
     }
 
-    void Update() {
-        currentScene.Update();
+    bool ExportProfile(const std::string& path) {
+        return Profiler::ExportChromeTrace(path);
+    }
+
+    // GPU upload time per frame for asynchronously loaded textures
+    void SetUploadBudget(double milliseconds) { uploadBudgetMs = milliseconds; }
+
+    // Scratch memory valid until the next Display()
+    FrameArena& GetFrameArena() { return frameArena; }
+
+    // Heap allocations made during the last completed frame; always 0 unless
+    // the allocation hook is installed (see AllocationCounter).
+    uint64_t GetFrameAllocations() const { return lastFrameAllocations; }
+
+    // Runs as many fixed ticks as the elapsed frame time covers (at most
+    // maxSubsteps, dropping the rest so a hitch can't snowball) and sets the
+    // render interpolation factor. Returns the number of ticks run.
+    // Headless engines don't look at the clock: every call runs exactly one
+    // tick, as fast as the caller loops.
+    int Update() {
+        if (mode == EngineMode::Headless) {
+            Tick(TickLength());
+            DeltaTime::SetInterpolation(1.0f);
+            return 1;
+        }
+
+        if (tickRate <= 0.0f) {
+            Tick(0.0f);
+            return 1;
+        }
+
+        const float step = 1.0f / tickRate;
+        accumulator += std::min(DeltaTime::Tick(), step * maxSubsteps);
+        int steps = 0;
+        while (accumulator >= step && steps < maxSubsteps) {
+            Tick(step);
+            accumulator -= step;
+            steps++;
+        }
+        if (steps == maxSubsteps) {
+            accumulator = std::min(accumulator, step);
+        }
+        DeltaTime::SetInterpolation(accumulator / step);
+        return steps;
+    }
+
+    // Runs `ticks` simulation steps back to back without drawing
+    void Simulate(uint64_t ticks) {
+        float step = TickLength();
+        for (uint64_t i = 0; i < ticks && !quitRequested; i++) {
+            Tick(step);
+        }
+        DeltaTime::SetInterpolation(1.0f);
+    }
+
+    // Record/replay. StartRecording reseeds Random (with its current seed)
+    // and captures every following tick's input, step length and state
+    // hash. Replay must start from the same scene setup as the recording;
+    // it reseeds Random the same way, runs the recorded ticks back to back
+    // with the recorded input and steps, and reports the first tick whose
+    // state hash differs. Built-in particle emitters draw from a
+    // scene-owned stream and replay exactly. Random::Local() streams are
+    // per worker, so code that draws from them on the job system (entity
+    // updates with SetParallelEntityUpdate, parallel component systems,
+    // systems sharing a level) needs JobSystem::SetDeterministic(true) for
+    // replays to match.
+    struct ReplayResult {
+        uint64_t ticks = 0;
+        int64_t firstDesync = -1; // Tick index, or -1 if every hash matched
+        uint64_t expectedHash = 0;
+        uint64_t actualHash = 0;
+
+        bool Matched() const { return firstDesync < 0; }
+    };
+
+    void StartRecording() {
+        recording.Clear();
+        recording.seed = Random::GetSeed();
+        Random::Seed(recording.seed);
+        Input::StartRecording(recording);
+    }
+
+    // Stops recording and writes it to `path`
+    bool StopRecording(const std::string& path) {
+        Input::StopStream();
+        return recording.Save(path);
+    }
+
+    const InputRecording& GetRecording() const { return recording; }
+
+    ReplayResult Replay(const InputRecording& source) {
+        ReplayResult result;
+        Random::Seed(source.seed);
+        Input::StartReplay(source);
+        for (const auto& expected : source.ticks) {
+            Input::BeginTick();
+            currentScene.Update(expected.dt);
+            uint64_t hash = currentScene.StateHash();
+            if (result.firstDesync < 0 && hash != expected.stateHash) {
+                result.firstDesync = static_cast<int64_t>(result.ticks);
+                result.expectedHash = expected.stateHash;
+                result.actualHash = hash;
+            }
+            result.ticks++;
+        }
+        Input::StopStream();
+        DeltaTime::SetInterpolation(1.0f);
+        return result;
+    }
+
+    void SetTickRate(float ticksPerSecond) {
+        tickRate = ticksPerSecond;
+        accumulator = 0.0f;
     }
 
+    void SetMaxSubsteps(int steps) { maxSubsteps = std::max(1, steps); }
+
+    float GetTickRate() const { return tickRate; }
+
+    // Draws the scene, through the scene's camera if one is set
     void Draw() {
+#ifndef GAME_ENGINE_HEADLESS
+        bool useCamera = mode == EngineMode::Windowed && currentScene.HasCamera();
+        if (useCamera) BeginMode2D(currentScene.GetCamera());
+        currentScene.Draw();
+        if (useCamera) EndMode2D();
+#else
         currentScene.Draw();
+#endif
     }
 
+    // Enables culling and world-space rendering; see Scene::SetCamera
+    void SetCamera(const Camera2D& camera) { currentScene.SetCamera(camera); }
+    void ClearCamera() { currentScene.ClearCamera(); }
+
     Scene& GetCurrentScene() {
         return currentScene;
     }
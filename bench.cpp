@@ -0,0 +1,990 @@
+// Headless benchmark suite. Builds without raylib (make bench) and prints
+// one JSON document to stdout so results can be tracked across commits.
+#define GAME_ENGINE_ALLOCATION_HOOK
+#include "GameEngine.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+using Clock = std::chrono::steady_clock;
+
+static double ElapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct Options {
+    size_t entities = 10000;
+    size_t frames = 300;
+    size_t threads = 0;
+    uint32_t seed = 1234;
+    bool quick = false;
+    size_t snapshotEntities = 1000000;
+    std::string tracePath;
+};
+
+static std::unique_ptr<GameEngine> MakeEngine(const Options& options) {
+    static std::unique_ptr<JobSystem> jobs;
+    auto engine = std::make_unique<GameEngine>(800, 600, "bench", EngineMode::Headless);
+    // Stress entities only touch themselves in Update
+    engine->GetCurrentScene().SetParallelEntityUpdate(true);
+    if (options.threads > 0) {
+        if (!jobs) jobs = std::make_unique<JobSystem>(options.threads - 1);
+        engine->GetCurrentScene().SetJobSystem(*jobs);
+    }
+    return engine;
+}
+
+static size_t WorkerCount(const Options& options) {
+    return options.threads > 0 ? options.threads - 1 : JobSystem::Default().WorkerCount();
+}
+
+// Stress entities
+class OrbitingEnemy : public Entity {
+private:
+    float time;
+    float radius;
+    Vector2 center;
+    float explosionTimer = 0;
+    bool exploding = false;
+
+public:
+    OrbitingEnemy(Vector2 orbitCenter, float orbitRadius, float phase, bool withParticles)
+        : time(phase), radius(orbitRadius), center(orbitCenter) {
+        size = Vector2{40, 40};
+        color = RED;
+        tag = "enemy";
+        position = Vector2{center.x + radius * cosf(time), center.y + radius * sinf(time)};
+
+        if (withParticles) {
+            ParticleEmitter particles;
+            particles.particleColor = YELLOW;
+            particles.particleLifetime = 1.0f;
+            particles.emitRate = 0;
+            particles.emitting = false;
+            particles.particleSpeed = 200.0f;
+            AddComponent("particles", particles);
+        }
+    }
+
+    static void RegisterSnapshot() {
+        Snapshot::RegisterEntity<OrbitingEnemy>("OrbitingEnemy", [](Scene& scene) {
+            return scene.Spawn<OrbitingEnemy>(Vector2{0, 0}, 0.0f, 0.0f, false);
+        })
+            .Field("time", &OrbitingEnemy::time)
+            .Field("radius", &OrbitingEnemy::radius)
+            .Field("center", &OrbitingEnemy::center)
+            .Field("explosionTimer", &OrbitingEnemy::explosionTimer)
+            .Field("exploding", &OrbitingEnemy::exploding);
+    }
+
+    // Naive text form for the snapshot comparison
+    void WriteText(std::ostream& out) const {
+        out << time << ' ' << radius << ' ' << center.x << ' ' << center.y << ' '
+            << explosionTimer << ' ' << exploding;
+    }
+
+    void ReadText(std::istream& in) {
+        in >> time >> radius >> center.x >> center.y >> explosionTimer >> exploding;
+    }
+
+    bool SameState(const OrbitingEnemy& other) const {
+        return time == other.time && radius == other.radius && center.x == other.center.x &&
+               center.y == other.center.y && explosionTimer == other.explosionTimer &&
+               exploding == other.exploding;
+    }
+
+    void Explode() {
+        if (!exploding) {
+            exploding = true;
+            if (auto particles = GetComponent<ParticleEmitter>()) {
+                particles->emitRate = 100;
+                particles->emitting = true;
+            }
+        }
+    }
+
+    void Update() override {
+        if (exploding) {
+            explosionTimer += DeltaTime::Get();
+            if (explosionTimer >= 1.0f) {
+                active = false;
+                return;
+            }
+            color.a = static_cast<unsigned char>(255 * (1.0f - explosionTimer));
+        } else {
+            time += DeltaTime::Get();
+            position.x = center.x + radius * cosf(time);
+            position.y = center.y + radius * sinf(time);
+            rotation += 90.0f * DeltaTime::Get();
+        }
+
+        Entity::Update();
+    }
+};
+
+class Drifter : public Entity {
+public:
+    Drifter(Vector2 start, Vector2 drift) {
+        position = start;
+        velocity = drift;
+        size = Vector2{8, 8};
+    }
+};
+
+// Scene runs
+struct SceneResult {
+    std::string name;
+    size_t entities = 0;
+    size_t frames = 0;
+    double updateNsPerEntity = 0;
+    double drawNsPerEntity = 0;
+    size_t drawCalls = 0;
+    size_t quads = 0;
+    double particlesPerFrame = 0;
+    double allocationsPerFrame = 0;
+    size_t framesWithAllocations = 0;
+};
+
+static SceneResult RunScene(const std::string& name, GameEngine& engine, size_t entityCount, size_t frames,
+                            const std::function<void(size_t frame)>& perFrame = nullptr) {
+    Scene& scene = engine.GetCurrentScene();
+
+    // Warm up so pools, batches and the spatial index reach steady size
+    for (size_t i = 0; i < 30; i++) {
+        engine.Clear();
+        engine.Update();
+        engine.Draw();
+        engine.Display();
+    }
+
+    SceneResult result;
+    result.name = name;
+    result.entities = entityCount;
+    result.frames = frames;
+
+    double updateNs = 0, drawNs = 0, particles = 0;
+    size_t framesWithAllocations = 0;
+    uint64_t allocationsBefore = AllocationCounter::Get();
+    for (size_t frame = 0; frame < frames; frame++) {
+        if (perFrame) perFrame(frame);
+        engine.Clear();
+        auto start = Clock::now();
+        engine.Update();
+        updateNs += ElapsedNs(start);
+
+        start = Clock::now();
+        engine.Draw();
+        drawNs += ElapsedNs(start);
+
+        particles += scene.GetParticleSystem().Count();
+        engine.Display();
+        if (engine.GetFrameAllocations() > 0) framesWithAllocations++;
+    }
+    uint64_t allocations = AllocationCounter::Get() - allocationsBefore;
+
+    double entityFrames = static_cast<double>(std::max<size_t>(entityCount, 1) * frames);
+    result.updateNsPerEntity = updateNs / entityFrames;
+    result.drawNsPerEntity = drawNs / entityFrames;
+    result.drawCalls = scene.GetRenderBatch().GetStats().drawCalls;
+    result.quads = scene.GetRenderBatch().GetStats().quads;
+    result.particlesPerFrame = particles / frames;
+    result.allocationsPerFrame = static_cast<double>(allocations) / frames;
+    result.framesWithAllocations = framesWithAllocations;
+    return result;
+}
+
+static SceneResult BenchEmitters(const Options& options) {
+    auto enginePtr = MakeEngine(options);
+    GameEngine& engine = *enginePtr;
+    Scene& scene = engine.GetCurrentScene();
+    scene.GetParticleSystem().SetCapacity(std::max<size_t>(65536, options.entities * 8));
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> pos(0.0f, 4000.0f);
+    for (size_t i = 0; i < options.entities; i++) {
+        Drifter* entity = scene.Spawn<Drifter>(Vector2{pos(rng), pos(rng)}, Vector2{10, 0});
+        ParticleEmitter particles;
+        particles.emitRate = 10;
+        particles.particleLifetime = 0.5f;
+        entity->AddComponent("particles", particles);
+    }
+    return RunScene("emitters", engine, options.entities, options.frames);
+}
+
+static SceneResult BenchCircular(const Options& options) {
+    auto enginePtr = MakeEngine(options);
+    GameEngine& engine = *enginePtr;
+    Scene& scene = engine.GetCurrentScene();
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> pos(0.0f, 4000.0f);
+    std::uniform_real_distribution<float> phase(0.0f, 2 * PI);
+    for (size_t i = 0; i < options.entities; i++) {
+        scene.Spawn<OrbitingEnemy>(Vector2{pos(rng), pos(rng)}, 100.0f, phase(rng), false);
+    }
+    // Gameplay-style collision pass whose pair list lives in the frame arena
+    size_t contacts = 0;
+    return RunScene("circular", engine, options.entities, options.frames, [&](size_t) {
+        contacts += scene.CollectOverlappingPairs().size();
+    });
+}
+
+// Everything explodes at once, emits for a second, then dies in the same tick
+static SceneResult BenchExplosion(const Options& options) {
+    auto enginePtr = MakeEngine(options);
+    GameEngine& engine = *enginePtr;
+    Scene& scene = engine.GetCurrentScene();
+    scene.GetParticleSystem().SetCapacity(std::max<size_t>(65536, options.entities * 16));
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> pos(0.0f, 4000.0f);
+    std::uniform_real_distribution<float> phase(0.0f, 2 * PI);
+    for (size_t i = 0; i < options.entities; i++) {
+        scene.Spawn<OrbitingEnemy>(Vector2{pos(rng), pos(rng)}, 100.0f, phase(rng), true);
+    }
+    size_t frames = std::max<size_t>(options.frames, 90);
+    return RunScene("explosion", engine, options.entities, frames, [&](size_t frame) {
+        if (frame == 0) {
+            for (Entity* enemy : scene.EntitiesWithTag("enemy")) static_cast<OrbitingEnemy*>(enemy)->Explode();
+        }
+    });
+}
+
+// The circular scene with entities made by make_shared on a heap churned
+// by other allocations, as in a long-running game, against Scene::Spawn.
+// Entities are updated and drawn in scene order either way, so the gap is
+// the cost of chasing scattered objects. Run under
+// `perf stat -e cache-misses` to see the misses directly.
+static std::vector<SceneResult> BenchEntityStorage(const Options& options) {
+    std::vector<SceneResult> results;
+    for (bool slab : {false, true}) {
+        auto enginePtr = MakeEngine(options);
+        GameEngine& engine = *enginePtr;
+        Scene& scene = engine.GetCurrentScene();
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<float> pos(0.0f, 4000.0f);
+        std::uniform_real_distribution<float> phase(0.0f, 2 * PI);
+        std::uniform_int_distribution<size_t> noiseSize(16, 512);
+        std::vector<std::unique_ptr<char[]>> noise;
+        for (size_t i = 0; i < options.entities; i++) {
+            Vector2 center{pos(rng), pos(rng)};
+            float start = phase(rng);
+            if (slab) {
+                scene.Spawn<OrbitingEnemy>(center, 100.0f, start, false);
+            } else {
+                scene.AddEntity(std::make_shared<OrbitingEnemy>(center, 100.0f, start, false));
+                for (int j = 0; j < 4; j++) noise.emplace_back(new char[noiseSize(rng)]);
+            }
+        }
+        // Free most of the noise so later allocations fill the holes
+        for (size_t i = 0; i < noise.size(); i++) {
+            if (i % 4 != 0) noise[i].reset();
+        }
+        results.push_back(RunScene(slab ? "slab" : "heap", engine, options.entities, options.frames));
+    }
+    return results;
+}
+
+// A world about 50x the screen area with a camera over one corner,
+// drawn with and without view culling. Animations are culled as well.
+static std::vector<SceneResult> BenchCulling(const Options& options) {
+    std::vector<SceneResult> results;
+    for (bool culled : {false, true}) {
+        auto enginePtr = MakeEngine(options);
+        GameEngine& engine = *enginePtr;
+        Scene& scene = engine.GetCurrentScene();
+        scene.GetParticleSystem().SetCapacity(std::max<size_t>(65536, options.entities * 8));
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<float> x(0.0f, 800.0f * 7), y(0.0f, 600.0f * 7);
+        for (size_t i = 0; i < options.entities; i++) {
+            Drifter* entity = scene.Spawn<Drifter>(Vector2{x(rng), y(rng)}, Vector2{10, 0});
+            ParticleEmitter particles;
+            particles.emitRate = 10;
+            particles.particleLifetime = 0.5f;
+            entity->AddComponent("particles", particles);
+            AnimationComponent animation;
+            animation.spriteSheet = Texture2D{3, 64, 8, 1, 7}; // Bucketing only; nothing uploads
+            animation.frameRect = Rectangle{0, 0, 8, 8};
+            animation.frameCount = 8;
+            entity->AddComponent("animation", animation);
+        }
+        if (culled) {
+            engine.SetCamera(Camera2D{Vector2{400, 300}, Vector2{400, 300}, 0.0f, 1.0f});
+            scene.SetCullAnimations(true);
+        }
+        results.push_back(RunScene(culled ? "world_culled" : "world", engine, options.entities, options.frames));
+    }
+    return results;
+}
+
+// Particle kernels
+struct KernelResult {
+    std::string kernel;
+    size_t particles;
+    double nsPerParticle;
+    bool matchesScalar;
+};
+
+static const char* KernelName(ParticleKernels::Kind kind) {
+    switch (kind) {
+        case ParticleKernels::Kind::AVX2: return "avx2";
+        case ParticleKernels::Kind::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+static void FillParticles(ParticleSystem& system, size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> pos(0.0f, 1000.0f), vel(-100.0f, 100.0f), life(0.5f, 5.0f);
+    system.Clear();
+    for (size_t i = 0; i < count; i++) {
+        system.Emit(Vector2{pos(rng), pos(rng)}, Vector2{vel(rng), vel(rng)}, life(rng), WHITE, 3.0f);
+    }
+}
+
+// Every live particle's state against the scalar reference, to a relative
+// epsilon that allows for SIMD rounding but not wrong results
+static bool SameParticles(const ParticleSystem& a, const ParticleSystem& b) {
+    if (a.Count() != b.Count()) return false;
+    auto close = [](float x, float y) {
+        return std::fabs(x - y) <= 1e-4f * std::max(1.0f, std::fabs(y));
+    };
+    for (size_t i = 0; i < a.Count(); i++) {
+        ParticleSystem::Particle p = a.GetParticle(i);
+        ParticleSystem::Particle q = b.GetParticle(i);
+        if (!close(p.position.x, q.position.x) || !close(p.position.y, q.position.y) ||
+            !close(p.velocity.x, q.velocity.x) || !close(p.velocity.y, q.velocity.y) ||
+            !close(p.lifetime, q.lifetime)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<KernelResult> BenchKernels(const Options& options) {
+    std::vector<KernelResult> results;
+    std::vector<size_t> sizes = options.quick ? std::vector<size_t>{10000, 100000}
+                                              : std::vector<size_t>{10000, 100000, 1000000};
+    const float dt = 1.0f / 60.0f;
+    for (size_t count : sizes) {
+        // Reference: scalar path over a few steps, including deaths
+        ParticleSystem reference(count);
+        reference.SetKernel(ParticleKernels::Kind::Scalar);
+        FillParticles(reference, count, options.seed);
+        for (int step = 0; step < 40; step++) reference.Update(dt);
+
+        for (auto kind : {ParticleKernels::Kind::Scalar, ParticleKernels::Kind::SSE2, ParticleKernels::Kind::AVX2}) {
+            if (!ParticleKernels::IsSupported(kind)) continue;
+            ParticleSystem system(count);
+            system.SetKernel(kind);
+
+            FillParticles(system, count, options.seed);
+            for (int step = 0; step < 40; step++) system.Update(dt);
+            bool matches = SameParticles(system, reference);
+
+            // Timing on a fresh pool with long lifetimes so the count is stable
+            FillParticles(system, count, options.seed);
+            int iterations = static_cast<int>(std::max<size_t>(10, 20000000 / count));
+            auto start = Clock::now();
+            for (int i = 0; i < iterations; i++) system.Update(dt * 0.001f);
+            double ns = ElapsedNs(start) / (static_cast<double>(iterations) * count);
+
+            results.push_back(KernelResult{KernelName(kind), count, ns, matches});
+        }
+    }
+    return results;
+}
+
+// Per-particle cost of the pre-pool design: AoS vector per emitter with a
+// remove_if pass every frame. Kept here as the "before" baseline.
+struct LegacyParticle {
+    Vector2 position;
+    Vector2 velocity;
+    float lifetime;
+    float maxLifetime;
+    Color color;
+    float size;
+    bool active = true;
+};
+
+static void LegacyUpdate(std::vector<LegacyParticle>& particles, float dt) {
+    for (auto& p : particles) {
+        if (!p.active) continue;
+        p.lifetime -= dt;
+        if (p.lifetime <= 0) {
+            p.active = false;
+            continue;
+        }
+        float lifePercent = p.lifetime / p.maxLifetime;
+        p.color.a = static_cast<unsigned char>(255 * lifePercent);
+        p.position.x += p.velocity.x * dt;
+        p.position.y += p.velocity.y * dt;
+        p.velocity.y += 200.0f * dt;
+    }
+    particles.erase(std::remove_if(particles.begin(), particles.end(),
+                                   [](const LegacyParticle& p) { return !p.active; }),
+                    particles.end());
+}
+
+struct PoolComparison {
+    size_t particles;
+    size_t emitters;
+    double legacyNsPerParticle;
+    double pooledNsPerParticle;
+};
+
+static PoolComparison BenchParticlePool(const Options& options) {
+    const size_t emitters = 1000;
+    const size_t perEmitter = options.quick ? 50 : 200;
+    const size_t total = emitters * perEmitter;
+    const float dt = 1.0f / 60.0f;
+    const int iterations = 100;
+
+    std::vector<std::vector<LegacyParticle>> legacy(emitters);
+    for (auto& list : legacy) {
+        for (size_t i = 0; i < perEmitter; i++) {
+            list.push_back(LegacyParticle{{0, 0}, {10, 10}, 1000.0f, 1000.0f, WHITE, 3.0f});
+        }
+    }
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (auto& list : legacy) LegacyUpdate(list, dt);
+    }
+    double legacyNs = ElapsedNs(start) / (static_cast<double>(iterations) * total);
+
+    ParticleSystem pool(total);
+    for (size_t i = 0; i < total; i++) pool.Emit(Vector2{0, 0}, Vector2{10, 10}, 1000.0f, WHITE, 3.0f);
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++) pool.Update(dt);
+    double pooledNs = ElapsedNs(start) / (static_cast<double>(iterations) * total);
+
+    return PoolComparison{total, emitters, legacyNs, pooledNs};
+}
+
+// Broadphase
+struct BroadphaseResult {
+    std::string method;
+    size_t entities;
+    double nsPerFrame;
+    size_t pairs;
+};
+
+static std::vector<BroadphaseResult> BenchBroadphase(const Options& options) {
+    std::vector<BroadphaseResult> results;
+    std::vector<size_t> sizes = options.quick ? std::vector<size_t>{2000, 10000}
+                                              : std::vector<size_t>{5000, 50000};
+    for (size_t count : sizes) {
+        for (auto method : {Broadphase::Grid, Broadphase::Tree}) {
+            auto enginePtr = MakeEngine(options);
+            GameEngine& engine = *enginePtr;
+            Scene& scene = engine.GetCurrentScene();
+            scene.SetBroadphase(method);
+            std::mt19937 rng(options.seed);
+            float world = std::sqrt(static_cast<float>(count)) * 40.0f;
+            std::uniform_real_distribution<float> pos(0.0f, world), vel(-60.0f, 60.0f);
+            for (size_t i = 0; i < count; i++) {
+                scene.AddEntity(std::make_shared<Drifter>(Vector2{pos(rng), pos(rng)}, Vector2{vel(rng), vel(rng)}));
+            }
+            engine.Simulate(5);
+
+            const int frames = 30;
+            size_t pairs = 0;
+            auto start = Clock::now();
+            for (int f = 0; f < frames; f++) {
+                engine.Update();
+                pairs = 0;
+                scene.ForEachOverlappingPair([&](Entity&, Entity&) { pairs++; });
+            }
+            double ns = ElapsedNs(start) / frames;
+            results.push_back(BroadphaseResult{method == Broadphase::Grid ? "grid" : "tree", count, ns, pairs});
+
+            // Brute force over Scene::GetEntities() on the same final state
+            if (count <= 10000) {
+                auto& entities = scene.GetEntities();
+                size_t brutePairs = 0;
+                start = Clock::now();
+                for (size_t i = 0; i < entities.size(); i++) {
+                    for (size_t j = i + 1; j < entities.size(); j++) {
+                        if (entities[i]->CheckCollision(*entities[j])) brutePairs++;
+                    }
+                }
+                double bruteNs = ElapsedNs(start);
+                if (method == Broadphase::Grid) {
+                    results.push_back(BroadphaseResult{"brute_force", count, bruteNs, brutePairs});
+                }
+            }
+        }
+    }
+    return results;
+}
+
+// Asset loading: reading every file up front on the main thread (the old
+// startup) against queuing them on ResourceManager and drawing frames
+// while the loader thread works. Headless builds only read the files, so
+// this measures I/O and the pipeline, not image decoding.
+struct AssetBenchResult {
+    size_t files;
+    size_t bytesPerFile;
+    double blockingMs;
+    double firstFrameMs;
+    double allReadyMs;
+    size_t framesWhileLoading;
+};
+
+static AssetBenchResult BenchAssets(const Options& options) {
+    const size_t files = options.quick ? 64 : 256;
+    const size_t bytesPerFile = 256 * 1024;
+    const std::string dir = std::filesystem::temp_directory_path().string() + "/bench_assets";
+    std::filesystem::create_directories(dir);
+    std::vector<std::string> paths;
+    std::vector<char> content(bytesPerFile, 7);
+    for (size_t i = 0; i < files; i++) {
+        paths.push_back(dir + "/sprite" + std::to_string(i) + ".png");
+        std::ofstream(paths.back(), std::ios::binary).write(content.data(), content.size());
+    }
+
+    AssetBenchResult result{files, bytesPerFile, 0, 0, 0, 0};
+    auto start = Clock::now();
+    for (const auto& path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> bytes(bytesPerFile);
+        file.read(bytes.data(), bytes.size());
+    }
+    result.blockingMs = ElapsedNs(start) / 1e6;
+
+    auto enginePtr = MakeEngine(options);
+    GameEngine& engine = *enginePtr;
+    start = Clock::now();
+    std::vector<TextureHandle> handles;
+    for (const auto& path : paths) handles.push_back(ResourceManager::LoadTexture(path));
+    engine.Clear();
+    engine.Update();
+    engine.Draw();
+    engine.Display();
+    result.firstFrameMs = ElapsedNs(start) / 1e6;
+    while (ResourceManager::PendingCount() > 0) {
+        engine.Clear();
+        engine.Update();
+        engine.Draw();
+        engine.Display();
+        result.framesWhileLoading++;
+    }
+    result.allReadyMs = ElapsedNs(start) / 1e6;
+
+    handles.clear();
+    std::filesystem::remove_all(dir);
+    return result;
+}
+
+// Record/replay: records a run of the explosion workload, replays it in a
+// freshly built engine and checks every tick's state hash matches. Also
+// shows what the per-tick hashing costs while recording.
+struct ReplayBenchResult {
+    size_t entities;
+    size_t ticks;
+    bool matched;
+    int64_t firstDesync;
+    double recordNsPerTick;
+    double replayNsPerTick;
+    double stateHashNs;
+};
+
+static ReplayBenchResult BenchReplay(const Options& options) {
+    const size_t ticks = std::max<size_t>(options.frames, 120);
+    auto build = [&] {
+        auto engine = MakeEngine(options);
+        Scene& scene = engine->GetCurrentScene();
+        scene.GetParticleSystem().SetCapacity(std::max<size_t>(65536, options.entities * 16));
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<float> pos(0.0f, 4000.0f);
+        std::uniform_real_distribution<float> phase(0.0f, 2 * PI);
+        for (size_t i = 0; i < options.entities; i++) {
+            auto* enemy = scene.Spawn<OrbitingEnemy>(Vector2{pos(rng), pos(rng)}, 100.0f, phase(rng), true);
+            if (i % 3 == 0) enemy->Explode();
+        }
+        return engine;
+    };
+
+    ReplayBenchResult result{options.entities, ticks, false, -1, 0, 0, 0};
+    InputRecording recording;
+    {
+        auto engine = build();
+        engine->StartRecording();
+        auto start = Clock::now();
+        engine->Simulate(ticks);
+        result.recordNsPerTick = ElapsedNs(start) / ticks;
+        Input::StopStream();
+        recording = engine->GetRecording();
+
+        start = Clock::now();
+        volatile uint64_t sink = 0;
+        for (int i = 0; i < 100; i++) sink = sink + engine->GetCurrentScene().StateHash();
+        result.stateHashNs = ElapsedNs(start) / 100;
+    }
+    {
+        auto engine = build();
+        auto start = Clock::now();
+        GameEngine::ReplayResult replay = engine->Replay(recording);
+        result.replayNsPerTick = ElapsedNs(start) / ticks;
+        result.matched = replay.Matched() && replay.ticks == ticks;
+        result.firstDesync = replay.firstDesync;
+    }
+    return result;
+}
+
+// World streaming: a world ten times the stress entity count, spread over
+// 32x32 chunks, ticked with everything resident against a WorldStreamer
+// whose focus crosses the world diagonally. Streamed ticks include the
+// streamer's own update and its chunk saves and loads.
+struct StreamingResult {
+    size_t worldEntities;
+    size_t chunks;
+    size_t ticks;
+    double fullNsPerTick;
+    double streamedNsPerTick;
+    size_t averageResident;
+    size_t peakResident;
+    size_t chunkLoads;
+    size_t chunkUnloads;
+};
+
+static StreamingResult BenchStreaming(const Options& options) {
+    OrbitingEnemy::RegisterSnapshot();
+    const size_t count = options.entities * 10;
+    const int chunksPerSide = 32;
+    const float chunkSize = 512.0f;
+    const float worldSize = chunksPerSide * chunkSize;
+    const size_t ticks = options.frames;
+    const std::string dir = std::filesystem::temp_directory_path().string() + "/bench_chunks";
+    auto populate = [&](Scene& scene) {
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<float> pos(0.0f, worldSize);
+        std::uniform_real_distribution<float> phase(0.0f, 2 * PI);
+        for (size_t i = 0; i < count; i++) {
+            scene.Spawn<OrbitingEnemy>(Vector2{pos(rng), pos(rng)}, 100.0f, phase(rng), false);
+        }
+    };
+    // Crosses the world once over the run
+    auto focusAt = [&](size_t tick) {
+        float t = static_cast<float>(tick) / static_cast<float>(std::max<size_t>(ticks, 1));
+        return Vector2{t * worldSize, t * worldSize};
+    };
+
+    StreamingResult result{count, size_t(chunksPerSide) * chunksPerSide, ticks, 0, 0, 0, 0, 0, 0};
+    {
+        auto engine = MakeEngine(options);
+        Scene& scene = engine->GetCurrentScene();
+        populate(scene);
+        auto start = Clock::now();
+        for (size_t i = 0; i < ticks; i++) scene.Update(1.0f / 60.0f);
+        result.fullNsPerTick = ElapsedNs(start) / ticks;
+    }
+    {
+        auto engine = MakeEngine(options);
+        Scene& scene = engine->GetCurrentScene();
+        populate(scene);
+        WorldStreamer streamer(scene, chunkSize, dir);
+        streamer.SetRadius(1, 2);
+        // Settle the starting area first, as a loading screen would
+        streamer.SetFocus(focusAt(0));
+        streamer.Update();
+        streamer.WaitIdle();
+        scene.Update(1.0f / 60.0f);
+
+        size_t residentTotal = 0;
+        auto start = Clock::now();
+        for (size_t i = 0; i < ticks; i++) {
+            streamer.SetFocus(focusAt(i));
+            streamer.Update();
+            scene.Update(1.0f / 60.0f);
+            size_t resident = scene.GetEntities().size();
+            residentTotal += resident;
+            result.peakResident = std::max(result.peakResident, resident);
+        }
+        result.streamedNsPerTick = ElapsedNs(start) / ticks;
+        result.averageResident = residentTotal / std::max<size_t>(ticks, 1);
+        streamer.WaitIdle();
+        WorldStreamer::Stats stats = streamer.GetStats();
+        result.chunkLoads = stats.chunkLoads;
+        result.chunkUnloads = stats.chunkUnloads;
+    }
+    std::filesystem::remove_all(dir);
+    return result;
+}
+
+// Snapshots: the binary format (raw and LZ-compressed, loaded from a mapped
+// file) against a naive line-per-entity text format, on a mid-simulation
+// scene
+struct SnapshotResult {
+    std::string format;
+    size_t entities;
+    size_t bytes;
+    double saveMs;
+    double loadMs;
+    bool roundTrip;
+};
+
+static void SaveText(Scene& scene, const std::string& path) {
+    std::ofstream file(path);
+    file.precision(9);
+    for (auto& entity : scene.GetEntities()) {
+        if (!entity->active) continue;
+        const Entity& e = *entity;
+        file << (e.tag.empty() ? "-" : e.tag) << ' ' << e.position.x << ' ' << e.position.y << ' '
+             << e.size.x << ' ' << e.size.y << ' ' << e.velocity.x << ' ' << e.velocity.y << ' '
+             << e.acceleration.x << ' ' << e.acceleration.y << ' ' << e.rotation << ' '
+             << e.collisionLayers << ' ' << int(e.color.r) << ' ' << int(e.color.g) << ' '
+             << int(e.color.b) << ' ' << int(e.color.a) << ' ';
+        static_cast<const OrbitingEnemy&>(e).WriteText(file);
+        if (auto* emitter = entity->GetComponent<ParticleEmitter>()) {
+            file << " 1 " << emitter->emitRate << ' ' << emitter->emitTimer << ' ' << emitter->emitting;
+        } else {
+            file << " 0";
+        }
+        file << '\n';
+    }
+}
+
+static void LoadText(Scene& scene, const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        auto* e = scene.Spawn<OrbitingEnemy>(Vector2{0, 0}, 0.0f, 0.0f, false);
+        std::string tag;
+        int r, g, b, a, hasEmitter;
+        in >> tag >> e->position.x >> e->position.y >> e->size.x >> e->size.y >> e->velocity.x
+           >> e->velocity.y >> e->acceleration.x >> e->acceleration.y >> e->rotation
+           >> e->collisionLayers >> r >> g >> b >> a;
+        e->color = Color{static_cast<unsigned char>(r), static_cast<unsigned char>(g),
+                         static_cast<unsigned char>(b), static_cast<unsigned char>(a)};
+        scene.SetTag(*e, tag == "-" ? "" : tag);
+        e->ReadText(in);
+        in >> hasEmitter;
+        if (hasEmitter) {
+            ParticleEmitter emitter;
+            in >> emitter.emitRate >> emitter.emitTimer >> emitter.emitting;
+            e->AddComponent("particles", emitter);
+        }
+        e->SavePreviousState();
+    }
+}
+
+static bool SameScene(Scene& a, Scene& b) {
+    auto& x = a.GetEntities();
+    auto& y = b.GetEntities();
+    if (x.size() != y.size()) return false;
+    for (size_t i = 0; i < x.size(); i++) {
+        const Entity& e = *x[i];
+        const Entity& f = *y[i];
+        if (e.position.x != f.position.x || e.position.y != f.position.y || e.rotation != f.rotation ||
+            e.velocity.x != f.velocity.x || e.size.x != f.size.x || e.tag != f.tag ||
+            e.collisionLayers != f.collisionLayers || e.color.a != f.color.a) {
+            return false;
+        }
+        if (!static_cast<const OrbitingEnemy&>(e).SameState(static_cast<const OrbitingEnemy&>(f))) return false;
+        auto* p = x[i]->GetComponent<ParticleEmitter>();
+        auto* q = y[i]->GetComponent<ParticleEmitter>();
+        if ((p == nullptr) != (q == nullptr)) return false;
+        if (p && (p->emitRate != q->emitRate || p->emitTimer != q->emitTimer || p->emitting != q->emitting)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<SnapshotResult> BenchSnapshot(const Options& options) {
+    OrbitingEnemy::RegisterSnapshot();
+    const size_t count = options.snapshotEntities;
+    const std::string dir = std::filesystem::temp_directory_path().string();
+    const std::string binaryPath = dir + "/bench_snapshot.bin";
+    const std::string textPath = dir + "/bench_snapshot.txt";
+
+    Scene source;
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<float> pos(0.0f, 4000.0f);
+    std::uniform_real_distribution<float> phase(0.0f, 2 * PI);
+    for (size_t i = 0; i < count; i++) {
+        source.Spawn<OrbitingEnemy>(Vector2{pos(rng), pos(rng)}, 100.0f, phase(rng), i % 4 == 0);
+    }
+    for (int i = 0; i < 3; i++) source.Update(1.0f / 60.0f);
+
+    std::vector<SnapshotResult> results;
+    auto measure = [&](const std::string& format, const std::string& path,
+                       const std::function<void()>& save, const std::function<void(Scene&)>& load) {
+        auto start = Clock::now();
+        save();
+        double saveMs = ElapsedNs(start) / 1e6;
+        auto loaded = std::make_unique<Scene>();
+        start = Clock::now();
+        load(*loaded);
+        double loadMs = ElapsedNs(start) / 1e6;
+        size_t bytes = static_cast<size_t>(std::filesystem::file_size(path));
+        results.push_back(SnapshotResult{format, count, bytes, saveMs, loadMs, SameScene(source, *loaded)});
+        std::filesystem::remove(path);
+    };
+    for (bool compress : {false, true}) {
+        measure(compress ? "binary_lz" : "binary", binaryPath,
+                [&] { Snapshot::Save(source, binaryPath, compress); },
+                [&](Scene& scene) { Snapshot::Load(binaryPath, scene); });
+    }
+    measure("text", textPath, [&] { SaveText(source, textPath); },
+            [&](Scene& scene) { LoadText(scene, textPath); });
+    return results;
+}
+
+// Output
+static void WriteScene(std::ostream& out, const SceneResult& r) {
+    out << "    {\"name\": \"" << r.name << "\", \"entities\": " << r.entities
+        << ", \"frames\": " << r.frames
+        << ", \"update_ns_per_entity\": " << r.updateNsPerEntity
+        << ", \"draw_ns_per_entity\": " << r.drawNsPerEntity
+        << ", \"draw_calls\": " << r.drawCalls
+        << ", \"quads\": " << r.quads
+        << ", \"particles_per_frame\": " << r.particlesPerFrame
+        << ", \"allocations_per_frame\": " << r.allocationsPerFrame
+        << ", \"frames_with_allocations\": " << r.framesWithAllocations << "}";
+}
+
+static Options ParseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        auto next = [&](size_t fallback) {
+            return i + 1 < argc ? static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)) : fallback;
+        };
+        if (!std::strcmp(argv[i], "--entities")) options.entities = next(options.entities);
+        else if (!std::strcmp(argv[i], "--frames")) options.frames = next(options.frames);
+        else if (!std::strcmp(argv[i], "--threads")) options.threads = next(options.threads);
+        else if (!std::strcmp(argv[i], "--seed")) options.seed = static_cast<uint32_t>(next(options.seed));
+        else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc) options.tracePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--quick")) {
+            options.quick = true;
+            options.entities = 2000;
+            options.frames = 60;
+            options.snapshotEntities = 20000;
+        } else if (!std::strcmp(argv[i], "--snapshot-entities")) {
+            options.snapshotEntities = next(options.snapshotEntities);
+        } else {
+            std::cerr << "usage: bench [--quick] [--entities N] [--frames N] [--threads N] [--seed N]\n"
+                         "             [--snapshot-entities N] [--trace FILE]\n";
+            std::exit(1);
+        }
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    Options options = ParseOptions(argc, argv);
+    // Profiling adds per-zone overhead, so traced runs aren't comparable
+    Profiler::SetEnabled(!options.tracePath.empty());
+    Random::Seed(options.seed);
+
+    std::vector<SceneResult> scenes = {
+        BenchEmitters(options),
+        BenchCircular(options),
+        BenchExplosion(options),
+    };
+    for (auto& result : BenchCulling(options)) scenes.push_back(result);
+    std::vector<SceneResult> storage = BenchEntityStorage(options);
+    std::vector<KernelResult> kernels = BenchKernels(options);
+    PoolComparison pool = BenchParticlePool(options);
+    std::vector<BroadphaseResult> broadphase = BenchBroadphase(options);
+    ReplayBenchResult replay = BenchReplay(options);
+    AssetBenchResult assets = BenchAssets(options);
+    StreamingResult streaming = BenchStreaming(options);
+    std::vector<SnapshotResult> snapshots = BenchSnapshot(options);
+
+    const double frameNs = 1e9 / 60.0;
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"config\": {\"entities\": " << options.entities << ", \"frames\": " << options.frames
+        << ", \"seed\": " << options.seed << ", \"workers\": " << WorkerCount(options)
+        << ", \"particle_kernel\": \"" << KernelName(ParticleKernels::Detect()) << "\"},\n";
+
+    out << "  \"scenes\": [\n";
+    for (size_t i = 0; i < scenes.size(); i++) {
+        WriteScene(out, scenes[i]);
+        out << (i + 1 < scenes.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    out << "  \"entity_storage\": [\n";
+    for (size_t i = 0; i < storage.size(); i++) {
+        WriteScene(out, storage[i]);
+        out << (i + 1 < storage.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    out << "  \"particle_kernels\": [\n";
+    for (size_t i = 0; i < kernels.size(); i++) {
+        const auto& k = kernels[i];
+        out << "    {\"kernel\": \"" << k.kernel << "\", \"particles\": " << k.particles
+            << ", \"ns_per_particle\": " << k.nsPerParticle
+            << ", \"matches_scalar\": " << (k.matchesScalar ? "true" : "false") << "}"
+            << (i + 1 < kernels.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    out << "  \"particle_pool\": {\"particles\": " << pool.particles << ", \"emitters\": " << pool.emitters
+        << ", \"legacy_aos_ns_per_particle\": " << pool.legacyNsPerParticle
+        << ", \"pooled_soa_ns_per_particle\": " << pool.pooledNsPerParticle
+        << ", \"legacy_particles_per_60fps_frame\": " << static_cast<uint64_t>(frameNs / pool.legacyNsPerParticle)
+        << ", \"pooled_particles_per_60fps_frame\": " << static_cast<uint64_t>(frameNs / pool.pooledNsPerParticle)
+        << "},\n";
+
+    out << "  \"broadphase\": [\n";
+    for (size_t i = 0; i < broadphase.size(); i++) {
+        const auto& b = broadphase[i];
+        out << "    {\"method\": \"" << b.method << "\", \"entities\": " << b.entities
+            << ", \"ns_per_frame\": " << b.nsPerFrame << ", \"pairs\": " << b.pairs << "}"
+            << (i + 1 < broadphase.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    out << "  \"replay\": {\"entities\": " << replay.entities << ", \"ticks\": " << replay.ticks
+        << ", \"matched\": " << (replay.matched ? "true" : "false")
+        << ", \"first_desync\": " << replay.firstDesync
+        << ", \"record_ns_per_tick\": " << replay.recordNsPerTick
+        << ", \"replay_ns_per_tick\": " << replay.replayNsPerTick
+        << ", \"state_hash_ns\": " << replay.stateHashNs << "},\n";
+
+    out << "  \"assets\": {\"files\": " << assets.files << ", \"bytes_per_file\": " << assets.bytesPerFile
+        << ", \"blocking_ms\": " << assets.blockingMs << ", \"first_frame_ms\": " << assets.firstFrameMs
+        << ", \"all_ready_ms\": " << assets.allReadyMs
+        << ", \"frames_while_loading\": " << assets.framesWhileLoading << "},\n";
+
+    out << "  \"streaming\": {\"world_entities\": " << streaming.worldEntities
+        << ", \"chunks\": " << streaming.chunks << ", \"ticks\": " << streaming.ticks
+        << ", \"full_ns_per_tick\": " << streaming.fullNsPerTick
+        << ", \"streamed_ns_per_tick\": " << streaming.streamedNsPerTick
+        << ", \"average_resident\": " << streaming.averageResident
+        << ", \"peak_resident\": " << streaming.peakResident
+        << ", \"chunk_loads\": " << streaming.chunkLoads
+        << ", \"chunk_unloads\": " << streaming.chunkUnloads << "},\n";
+
+    out << "  \"snapshot\": [\n";
+    for (size_t i = 0; i < snapshots.size(); i++) {
+        const auto& r = snapshots[i];
+        out << "    {\"format\": \"" << r.format << "\", \"entities\": " << r.entities
+            << ", \"bytes\": " << r.bytes << ", \"save_ms\": " << r.saveMs << ", \"load_ms\": " << r.loadMs
+            << ", \"round_trip\": " << (r.roundTrip ? "true" : "false") << "}"
+            << (i + 1 < snapshots.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+
+    std::cout << out.str();
+
+    for (const auto& k : kernels) {
+        if (!k.matchesScalar) {
+            std::cerr << "bench: " << k.kernel << " particle kernel disagrees with scalar at "
+                      << k.particles << " particles\n";
+            return 1;
+        }
+    }
+
+    if (!options.tracePath.empty() && !Profiler::ExportChromeTrace(options.tracePath)) {
+        std::cerr << "bench: could not write " << options.tracePath << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,11 @@
 #include "GameEngine.hpp"
 #include <iostream>
 
+enum CollisionLayer : uint32_t {
+    LayerPlayer = 1 << 0,
+    LayerEnemy = 1 << 1
+};
+
 class Player : public Entity {
 public:
     Player() {
@@ -8,14 +13,15 @@ public:
         color = WHITE;
         position = Vector2{400, 300};
         tag = "player";
+        collisionLayers = LayerPlayer;
 
         // Add thrust particles
-        auto particles = std::make_shared<ParticleEmitter>();
-        particles->particleColor = ORANGE;
-        particles->particleLifetime = 0.5f;
-        particles->emitRate = 20;
-        particles->particleSpeed = 50.0f;
-        particles->offset = Vector2{-25, 0};
+        ParticleEmitter particles;
+        particles.particleColor = ORANGE;
+        particles.particleLifetime = 0.5f;
+        particles.emitRate = 20;
+        particles.particleSpeed = 50.0f;
+        particles.offset = Vector2{-25, 0};
         AddComponent("particles", particles);
     }
 
@@ -23,26 +29,26 @@ public:
         velocity = {0, 0};
         const float speed = 300.0f;
         
-        if (IsKeyDown(KEY_RIGHT)) {
+        if (Input::IsKeyDown(KEY_RIGHT)) {
             velocity.x = speed;
             rotation = 0;
         }
-        else if (IsKeyDown(KEY_LEFT)) {
+        else if (Input::IsKeyDown(KEY_LEFT)) {
             velocity.x = -speed;
             rotation = 180;
         }
 
-        if (IsKeyDown(KEY_DOWN)) {
+        if (Input::IsKeyDown(KEY_DOWN)) {
             velocity.y = speed;
             rotation = 90;
         }
-        else if (IsKeyDown(KEY_UP)) {
+        else if (Input::IsKeyDown(KEY_UP)) {
             velocity.y = -speed;
             rotation = 270;
         }
 
         // Enable particles when moving
-        if (auto particles = GetComponent<ParticleEmitter>("particles")) {
+        if (auto particles = GetComponent<ParticleEmitter>()) {
             particles->emitting = (velocity.x != 0 || velocity.y != 0);
         }
 
@@ -68,22 +74,30 @@ public:
         color = RED;
         position = Vector2{x, y};
         tag = "enemy";
-
-        // Add explosion particles
-        auto particles = std::make_shared<ParticleEmitter>();
-        particles->particleColor = YELLOW;
-        particles->particleLifetime = 1.0f;
-        particles->emitRate = 0;
-        particles->particleSpeed = 200.0f;
+        collisionLayers = LayerEnemy;
+
+        // Add explosion particles (settings shared by every enemy)
+        static const PresetId explosion = ParticlePresets::Add([] {
+            ParticlePreset preset;
+            preset.lifetimeMin = 0.6f;
+            preset.lifetimeMax = 1.0f;
+            preset.speedMin = 100.0f;
+            preset.speedMax = 200.0f;
+            preset.startColor = YELLOW;
+            preset.endColor = RED;
+            return preset;
+        }());
+        ParticleEmitter particles;
+        particles.preset = explosion;
+        particles.emitRate = 0;
         AddComponent("particles", particles);
     }
 
     void Explode() {
         if (!exploding) {
             exploding = true;
-            if (auto particles = GetComponent<ParticleEmitter>("particles")) {
-                particles->emitRate = 100;
-                particles->emitting = true;
+            if (auto particles = GetComponent<ParticleEmitter>()) {
+                particles->Burst(100);
             }
         }
     }
@@ -114,28 +128,40 @@ int main() {
     Scene& scene = engine.GetCurrentScene();
 
     // Create player
-    auto player = std::make_shared<Player>();
-    scene.AddEntity(player);
+    Player* player = scene.Spawn<Player>();
 
     // Create enemies
-    scene.AddEntity(std::make_shared<Enemy>(200, 200));
-    scene.AddEntity(std::make_shared<Enemy>(600, 400));
+    scene.Spawn<Enemy>(200, 200);
+    scene.Spawn<Enemy>(600, 400);
+
+    // Trigger explosions on contact. Runs inside the tick, after the
+    // collision index is rebuilt, so replays see the same hits
+    scene.AddSystem("hits", [player](Scene& scene) {
+        scene.QueryAABB(player->GetBounds(), [](Entity& enemy) {
+            static_cast<Enemy&>(enemy).Explode();
+        }, LayerEnemy);
+    }, {"collision"});
 
     // Game loop
     while (!engine.ShouldClose()) {
         engine.Clear();
 
         // Toggle debug mode
-        if (IsKeyPressed(KEY_F1)) {
+        if (Input::IsFrameKeyPressed(KEY_F1)) {
             engine.ToggleDebugMode();
         }
 
-        // Check collisions and trigger explosions
-        auto enemies = scene.GetEntitiesByTag("enemy");
-        for (auto& enemy : enemies) {
-            if (player->CheckCollision(*enemy)) {
-                std::static_pointer_cast<Enemy>(enemy)->Explode();
-            }
+        // Dump the recorded profile for chrome://tracing
+        if (Input::IsFrameKeyPressed(KEY_F2)) {
+            engine.ExportProfile("profile.json");
+        }
+
+        // Record input and per-tick state hashes for replays
+        if (Input::IsFrameKeyPressed(KEY_F3) && !Input::IsRecording()) {
+            engine.StartRecording();
+        }
+        if (Input::IsFrameKeyPressed(KEY_F4) && Input::IsRecording()) {
+            engine.StopRecording("replay.bin");
         }
 
         engine.Update();